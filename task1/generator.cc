@@ -0,0 +1,244 @@
+// Generator syntetycznych danych wejściowych dla kasy: bilety, kursy linii jeżdżących
+// według taktu przez cały dzień i zapytania o tym samym kształcie co prawdziwy ruch.
+//
+//   g++ -std=c++17 -O2 generator.cc -o generator
+//   ./generator --stops 2000 --courses 50000 --tickets 20 --queries 500000 --mix 80:10:10 > dane.txt
+//
+// --mix to wagi zapytań o bilety (?), o podróż (>) i o odjazdy (@). Część zapytań o bilety
+// celowo wymaga czekania na przesiadce albo jest błędna, tak jak w zwykłym ruchu.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using std::cerr;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+using minuta_dnia = int;
+using numer_kursu = uint64_t;
+using kurs = vector<std::pair<size_t, minuta_dnia>>; // przystanek, godzina
+
+const minuta_dnia poczatek_pracy = 5 * 60 + 55;
+const minuta_dnia koniec_pracy = 21 * 60 + 21;
+
+struct parametry {
+    size_t przystanki = 1000;
+    size_t kursy = 10000;
+    size_t bilety = 10;
+    size_t zapytania = 100000;
+    size_t kursow_na_linie = 40;
+    unsigned wagi[3] = {80, 10, 10}; // ?, >, @
+    uint64_t ziarno = 1;
+};
+
+// Nazwy przystanków nie mogą zawierać cyfr, więc numer zapisujemy literami.
+string nazwaPrzystanku(size_t i) {
+    string nazwa = "St_";
+    do {
+        nazwa += static_cast<char>('a' + i % 26);
+        i /= 26;
+    } while (i > 0);
+    return nazwa;
+}
+
+string nazwaBiletu(size_t i) {
+    string nazwa = "Bilet ";
+    do {
+        nazwa += static_cast<char>('A' + i % 26);
+        i /= 26;
+    } while (i > 0);
+    return nazwa;
+}
+
+string godzina(minuta_dnia m) {
+    string wynik = std::to_string(m / 60) + ":";
+    wynik += static_cast<char>('0' + m % 60 / 10);
+    wynik += static_cast<char>('0' + m % 10);
+    return wynik;
+}
+
+class Generator {
+  public:
+    explicit Generator(const parametry &p) : p(p), los(p.ziarno) {}
+
+    void generuj(std::ostream &wyjscie) {
+        bilety();
+        kursy();
+        std::discrete_distribution<int> rodzaj({double(p.wagi[0]), double(p.wagi[1]), double(p.wagi[2])});
+        for (size_t i = 0; i < p.zapytania; i++) {
+            switch (rodzaj(los)) {
+            case 0:
+                zapytanieOBilety();
+                break;
+            case 1:
+                zapytanieOPodroz();
+                break;
+            default:
+                zapytanieOOdjazdy();
+                break;
+            }
+        }
+        wyjscie.write(tekst.data(), tekst.size());
+    }
+
+  private:
+    size_t losowa(size_t od, size_t do_) { return std::uniform_int_distribution<size_t>(od, do_)(los); }
+
+    // Ceny rosną wolniej niż czas ważności, więc dłuższe bilety bywają opłacalne.
+    void bilety() {
+        const minuta_dnia typowe[] = {15, 20, 30, 40, 60, 75, 90, 120, 180, 240, 360, 1440};
+        for (size_t i = 0; i < p.bilety; i++) {
+            minuta_dnia czas = i < std::size(typowe) ? typowe[i] : static_cast<minuta_dnia>(losowa(1, 1000));
+            size_t grosze = 100 + static_cast<size_t>(40.0 * std::pow(czas, 0.75)) + losowa(0, 99);
+            tekst += nazwaBiletu(i) + " " + std::to_string(grosze / 100) + "." + std::to_string(grosze / 10 % 10) +
+                     std::to_string(grosze % 10) + " " + std::to_string(czas) + "\n";
+        }
+    }
+
+    // Linia to stała trasa z czasami przejazdu; jej kursy ruszają co stały takt.
+    void kursy() {
+        size_t liczba_linii = std::max<size_t>(1, (p.kursy + p.kursow_na_linie - 1) / p.kursow_na_linie);
+        numer_kursu numer = 100;
+        for (size_t l = 0; l < liczba_linii && wszystkie.size() < p.kursy; l++) {
+            size_t dlugosc = std::min(p.przystanki, losowa(3, 20));
+            vector<size_t> trasa;
+            while (trasa.size() < dlugosc) {
+                size_t przyst = losowa(0, p.przystanki - 1);
+                if (std::find(trasa.begin(), trasa.end(), przyst) == trasa.end()) {
+                    trasa.push_back(przyst);
+                }
+            }
+            vector<minuta_dnia> odstepy{0};
+            for (size_t i = 1; i < dlugosc; i++) {
+                odstepy.push_back(odstepy.back() + static_cast<minuta_dnia>(losowa(1, 6)));
+            }
+            minuta_dnia ostatni_start = koniec_pracy - odstepy.back();
+            minuta_dnia takt = std::max<minuta_dnia>(1, (ostatni_start - poczatek_pracy) / p.kursow_na_linie);
+            minuta_dnia start = poczatek_pracy + static_cast<minuta_dnia>(losowa(0, takt - 1));
+            for (; start <= ostatni_start && wszystkie.size() < p.kursy; start += takt) {
+                numer += losowa(1, 10);
+                kurs k;
+                tekst += std::to_string(numer);
+                for (size_t i = 0; i < dlugosc; i++) {
+                    k.emplace_back(trasa[i], start + odstepy[i]);
+                    tekst += " " + godzina(start + odstepy[i]) + " " + nazwaPrzystanku(trasa[i]);
+                    postoje[trasa[i]].emplace_back(start + odstepy[i], wszystkie.size());
+                }
+                tekst += "\n";
+                numery.push_back(numer);
+                wszystkie.push_back(std::move(k));
+            }
+        }
+        for (auto &[przyst, lista] : postoje) {
+            std::sort(lista.begin(), lista.end());
+        }
+    }
+
+    // Odcinek losowego kursu, czasem z przesiadką na kurs odjeżdżający z przystanku
+    // przesiadkowego dokładnie o godzinie przyjazdu albo później (wtedy trzeba czekać).
+    // Co dwudziesty przypadek ma odwróconą kolejność przystanków, więc jest błędny.
+    void zapytanieOBilety() {
+        size_t k = losowa(0, wszystkie.size() - 1);
+        const kurs &pierwszy = wszystkie[k];
+        size_t a = losowa(0, pierwszy.size() - 2), b = losowa(a + 1, pierwszy.size() - 1);
+        if (losowa(0, 19) == 0) {
+            std::swap(a, b);
+        }
+        tekst += "? " + nazwaPrzystanku(pierwszy[a].first) + " " + std::to_string(numery[k]) + " " +
+                 nazwaPrzystanku(pierwszy[b].first);
+        if (a < b && losowa(0, 2) == 0) {
+            const auto &lista = postoje[pierwszy[b].first];
+            auto it = std::lower_bound(lista.begin(), lista.end(), std::make_pair(pierwszy[b].second, size_t{0}));
+            while (it != lista.end() && it->second == k) {
+                ++it;
+            }
+            if (it != lista.end()) {
+                const kurs &drugi = wszystkie[it->second];
+                auto postoj = std::find_if(drugi.begin(), drugi.end(),
+                                           [&](const auto &pp) { return pp.first == pierwszy[b].first; });
+                if (postoj + 1 < drugi.end()) {
+                    auto cel = postoj + 1 + losowa(0, drugi.end() - postoj - 2);
+                    tekst += " " + std::to_string(numery[it->second]) + " " + nazwaPrzystanku(cel->first);
+                }
+            }
+        }
+        tekst += "\n";
+    }
+
+    void zapytanieOPodroz() {
+        size_t skad = losowa(0, p.przystanki - 1), dokad = losowa(0, p.przystanki - 1);
+        minuta_dnia odjazd = static_cast<minuta_dnia>(losowa(poczatek_pracy, koniec_pracy));
+        tekst += "> " + nazwaPrzystanku(skad) + " " + godzina(odjazd) + " " + nazwaPrzystanku(dokad) + "\n";
+    }
+
+    void zapytanieOOdjazdy() {
+        size_t przyst = losowa(0, p.przystanki - 1);
+        minuta_dnia od = static_cast<minuta_dnia>(losowa(poczatek_pracy, koniec_pracy));
+        tekst += "@ " + nazwaPrzystanku(przyst) + " " + godzina(od) + " " + std::to_string(losowa(1, 10)) + "\n";
+    }
+
+    parametry p;
+    std::mt19937_64 los;
+    vector<kurs> wszystkie;
+    vector<numer_kursu> numery;
+    std::unordered_map<size_t, vector<std::pair<minuta_dnia, size_t>>> postoje; // przystanek -> (godzina, kurs)
+    string tekst;
+};
+
+bool wczytajWagi(string_view tekst, unsigned (&wagi)[3]) {
+    string kopia(tekst);
+    char *pozycja = kopia.data();
+    for (size_t i = 0; i < 3; i++) {
+        char *koniec;
+        wagi[i] = std::strtoul(pozycja, &koniec, 10);
+        if (koniec == pozycja || (i < 2 && *koniec != ':') || (i == 2 && *koniec != '\0')) {
+            return false;
+        }
+        pozycja = koniec + 1;
+    }
+    return wagi[0] + wagi[1] + wagi[2] > 0;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    parametry p;
+    for (int i = 1; i < argc; i++) {
+        string_view opcja = argv[i];
+        bool ma_wartosc = i + 1 < argc;
+        if (opcja == "--stops" && ma_wartosc) {
+            p.przystanki = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--courses" && ma_wartosc) {
+            p.kursy = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--courses-per-line" && ma_wartosc) {
+            p.kursow_na_linie = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--tickets" && ma_wartosc) {
+            p.bilety = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--queries" && ma_wartosc) {
+            p.zapytania = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--seed" && ma_wartosc) {
+            p.ziarno = std::strtoull(argv[++i], nullptr, 10);
+        } else if (opcja == "--mix" && ma_wartosc) {
+            if (!wczytajWagi(argv[++i], p.wagi)) {
+                cerr << "--mix expects three weights, e.g. 80:10:10\n";
+                return 1;
+            }
+        } else {
+            cerr << "Unknown option: " << opcja << "\n";
+            return 1;
+        }
+    }
+    if (p.przystanki < 3 || p.kursy == 0 || p.kursow_na_linie == 0) {
+        cerr << "At least 3 stops, 1 course and 1 course per line are needed\n";
+        return 1;
+    }
+    Generator(p).generuj(std::cout);
+}
@@ -1,139 +1,583 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 using std::begin;
 using std::cerr;
 using std::cout;
 using std::end;
 using std::get;
-using std::istream;
-using std::map;
 using std::optional;
 using std::ostream;
 using std::pair;
 using std::string;
+using std::string_view;
 using std::tuple;
 using std::variant;
 using std::vector;
 
-namespace RE {
-using std::regex;
-regex nazwa_biletu("([a-zA-Z ]+) ");
-regex zapytanie_o_bilety("^\\?"                    // znak zapytania
-                         "( [a-zA-Z_\\^]+ \\d+)+ " // para: (przystanek, numer kursu)
-                         "([a-zA-Z_\\^]+)$");      // ostatni przystanek
-regex dodaj_bilet("^([a-zA-Z ]+)"                  // nazwa biletu
-                  " "
-                  "(\\d+\\.\\d{2})" // cena
-                  " "
-                  "([1-9]\\d*)$"); // czas w minutach
-regex dodaj_kurs("^(\\d+)"         // numer kursu
-                 "( [1-9]\\d?:\\d{2} [a-zA-Z_\\^]+)+$");
-} // namespace RE
-
 // wzięte z https://en.cppreference.com/w/cpp/utility/variant/visit
 template <class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
 template <class... Ts> overloaded(Ts...)->overloaded<Ts...>;
 
-template <typename S, typename T> std::optional<T> wybierzZMapy(const map<S, T> &m, const S &klucz) {
-    auto v = m.find(klucz);
-    if (v == end(m)) {
-        return {};
-    }
-    return std::make_optional(v->second);
-}
-
 namespace {
 using punkt_w_czasie = pair<uint16_t, uint16_t>; // godzina, minuta
+using minuta_dnia = uint16_t;                    // minuty od północy
 using przystanek = string;
-using kurs = map<przystanek, punkt_w_czasie>; // przystanek -> czas
+using id_przystanku = uint32_t;
+using postoj = pair<id_przystanku, minuta_dnia>;
+using kurs = vector<postoj>; // postoje w kolejności przejazdu
 using numer_kursu = uint64_t;
-using rozklad_kursow = map<numer_kursu, kurs>; // numer linii -> linia
+
+// Nazwy przystanków zamienione na gęste identyfikatory; std::deque nie przenosi
+// elementów, więc klucze słownika mogą wskazywać na przechowywane nazwy.
+struct slownik_przystankow {
+    std::deque<przystanek> nazwy;
+    std::unordered_map<string_view, id_przystanku> identyfikatory;
+
+    slownik_przystankow() = default;
+    slownik_przystankow(slownik_przystankow &&) = default;
+    slownik_przystankow &operator=(slownik_przystankow &&) = default;
+    // kopia musi wskazywać na własne nazwy
+    slownik_przystankow(const slownik_przystankow &inny) : nazwy(inny.nazwy) {
+        for (id_przystanku id = 0; id < nazwy.size(); id++) {
+            identyfikatory.emplace(nazwy[id], id);
+        }
+    }
+    slownik_przystankow &operator=(const slownik_przystankow &inny) {
+        slownik_przystankow kopia(inny);
+        return *this = std::move(kopia);
+    }
+};
+const id_przystanku nieznany_przystanek = std::numeric_limits<id_przystanku>::max();
+
+// Odcinek kursu między dwoma kolejnymi przystankami; kurs to jego gęsty indeks w siatce.
+struct polaczenie {
+    minuta_dnia odjazd, przyjazd;
+    id_przystanku skad, dokad;
+    uint32_t kurs;
+};
+
+// Połączenia wszystkich kursów posortowane po odjeździe (remisy rozstrzyga scalPolaczenia),
+// dla wyszukiwarki połączeń.
+// Połączenia nowych kursów czekają w nowe_polaczenia, aż zapytanie je scali.
+struct siatka_polaczen {
+    vector<polaczenie> polaczenia;
+    vector<polaczenie> nowe_polaczenia;
+    vector<numer_kursu> numery_kursow; // gęsty indeks kursu -> numer
+};
+
+// Odjazd kursu z przystanku; odjazdy z każdego przystanku są trzymane posortowane.
+using odjazd = pair<minuta_dnia, numer_kursu>;
+
+struct rozklad_kursow {
+    slownik_przystankow przystanki;
+    vector<kurs> kursy; // gęsty indeks kursu (ten sam co w siatce) -> linia
+    std::unordered_map<numer_kursu, uint32_t> indeksy_kursow; // numer linii -> gęsty indeks
+    siatka_polaczen siatka;
+    vector<vector<odjazd>> odjazdy; // id przystanku -> odjazdy
+    uint64_t pokolenie = 0; // zwiększane przy każdym dodanym kursie
+};
 
 using minuty = uint64_t;
 using cena_grosze = uint64_t;
 enum bilet_indeks { NAZWA, CENA, CZAS_WAZNOSCI };
 using bilet = tuple<string, cena_grosze, minuty>;
 
-using trzeba_czekac = przystanek; // gdzie trzeba czekać
+using trzeba_czekac = string_view; // gdzie trzeba czekać; nazwa ze słownika przystanków
 using zestaw_biletow = vector<bilet>;
 struct blad {};
+using czas_trasy = variant<minuty, id_przystanku, blad>; // id przystanku, na którym trzeba czekać
+
+const size_t domyslnie_biletow = 3; // ile biletów najwyżej można kupić na jeden przejazd
+const cena_grosze brak_zestawu = std::numeric_limits<cena_grosze>::max();
+// Najtańszy ciąg biletów ważny dłużej niż zadany czas: pierwszy bilet ciągu i jego cena;
+// reszta ciągu to plan o jeden bilet krótszy na pozycji pozycjaPoBilecie(pozycja, ważność).
+struct krok_planu {
+    cena_grosze cena = brak_zestawu;
+    uint32_t bilet = 0;
+};
+// warstwa[t + 1] - najlepszy plan dla przejazdu trwającego t minut; warstwa[0] to
+// t = -1, czyli dowolny plan (także dla czasów ujemnych po odjęciu ważności biletu)
+using warstwa_planow = vector<krok_planu>;
+// Odpowiedź optymalizatora: cena i pozycja planu w ostatniej warstwie katalogu.
+struct plan_biletow {
+    cena_grosze cena = brak_zestawu;
+    size_t pozycja = 0;
+};
+
+struct katalog_biletow {
+    zestaw_biletow bilety{{}}; // pusty bilet za 0 gr pozwala kupić mniej niż maks_biletow biletów
+    // front Pareto (cena, czas ważności) - tylko te bilety biorą udział w optymalizacji;
+    // pełna lista służy do sprawdzania nazw i wypisywania
+    vector<uint32_t> niezdominowane{0};
+    size_t maks_biletow = domyslnie_biletow;
+    vector<warstwa_planow> warstwy; // warstwy[m] - plany z m biletów, m <= maks_biletow
+    bool aktualne_warstwy = false;
+};
+
+// Ograniczona pamięć wyników znajdzCzasTrasy dla powtarzających się tras, kluczowana ciągiem
+// identyfikatorów przystanków i numerów kursów; każdy klucz ma jedno miejsce w tablicy, a kolizja
+// nadpisuje starszy wpis. Dodany kurs już się nie zmienia, więc nieaktualny może stać się tylko
+// wynik blad (gdy trasa używała brakującego kursu) - taki wpis ważny jest tylko w pokoleniu
+// rozkładu, w którym go policzono.
+class PamiecTras {
+  public:
+    explicit PamiecTras(size_t pojemnosc = 1 << 14) : wpisy(pojemnosc) {}
+
+    template <typename F>
+    czas_trasy pobierz(const std::pmr::vector<id_przystanku> &przystanki, const std::pmr::vector<numer_kursu> &numeryKursow,
+                       uint64_t pokolenie, F oblicz) {
+        // przystanków jest o jeden więcej niż kursów, więc długość klucza rozdziela obie części
+        klucz.assign(begin(przystanki), end(przystanki));
+        klucz.insert(end(klucz), begin(numeryKursow), end(numeryKursow));
+        uint64_t skrot = 14695981039346656037ULL;
+        for (uint64_t x : klucz) {
+            skrot = (skrot ^ x) * 1099511628211ULL;
+        }
+        wpis &w = wpisy[skrot % wpisy.size()];
+        if (w.zajety && w.klucz == klucz && (!std::holds_alternative<blad>(w.wynik) || w.pokolenie == pokolenie)) {
+            trafienia++;
+            return w.wynik;
+        }
+        chybienia++;
+        w.zajety = true;
+        // kopia zamiast zamiany, żeby bufory klucza nie krążyły między wpisami i nie trzeba ich było znów przydzielać
+        w.klucz.assign(begin(klucz), end(klucz));
+        w.wynik = oblicz();
+        w.pokolenie = pokolenie;
+        return w.wynik;
+    }
+
+    size_t liczbaTrafien() const { return trafienia; }
+    size_t liczbaChybien() const { return chybienia; }
+
+    // Dolicza trafienia i chybienia innej pamięci, np. sesji serwera.
+    void dolicz(const PamiecTras &inna) {
+        trafienia += inna.trafienia;
+        chybienia += inna.chybienia;
+    }
+
+  private:
+    struct wpis {
+        bool zajety = false;
+        vector<uint64_t> klucz;
+        czas_trasy wynik;
+        uint64_t pokolenie = 0;
+    };
+
+    vector<wpis> wpisy;
+    vector<uint64_t> klucz;
+    size_t trafienia = 0, chybienia = 0;
+};
+
+struct stan_kasy {
+    katalog_biletow bilety;
+    rozklad_kursow rozklad;
+    PamiecTras trasy;
+    size_t liczba_sprzedanych_biletow = 0;
+};
+
 struct nie_da_sie_kupic_biletu {};
-using wynik_zapytania = variant<zestaw_biletow, trzeba_czekac, nie_da_sie_kupic_biletu, blad>;
+// Trasa znaleziona przez wyszukiwarkę połączeń, w postaci zapytania o bilety, wraz z biletami
+// (cena brak_zestawu, gdy nie da się ich kupić).
+struct plan_podrozy {
+    vector<string_view> przystanki;
+    vector<numer_kursu> numeryKursow;
+    minuty czas;
+    plan_biletow bilety;
+};
+struct tablica_odjazdow {
+    vector<odjazd> odjazdy;
+};
+using wynik_zapytania =
+    variant<plan_biletow, trzeba_czekac, nie_da_sie_kupic_biletu, plan_podrozy, tablica_odjazdow, blad>;
+
+// Odpowiedzi są składane w buforze wielokrotnego użytku i wypisywane dużymi porcjami.
+// Bez strumienia docelowego bufor tylko zbiera tekst, który odbiera się przez zabierz().
+class BuforWyjscia {
+  public:
+    explicit BuforWyjscia(ostream *cel = nullptr) : cel(cel) { dane.reserve(rozmiar_porcji); }
+    BuforWyjscia(const BuforWyjscia &) = delete;
+    BuforWyjscia &operator=(const BuforWyjscia &) = delete;
+    ~BuforWyjscia() { oproznij(); }
+
+    BuforWyjscia &operator<<(string_view tekst) {
+        dane.append(tekst);
+        if (cel != nullptr && dane.size() >= rozmiar_porcji) {
+            oproznij();
+        }
+        return *this;
+    }
+
+    BuforWyjscia &operator<<(size_t liczba) {
+        char cyfry[std::numeric_limits<size_t>::digits10 + 1];
+        auto [koniec, kod] = std::to_chars(std::begin(cyfry), std::end(cyfry), liczba);
+        return *this << string_view(cyfry, koniec - cyfry);
+    }
+
+    void oproznij() {
+        if (cel != nullptr) {
+            cel->write(dane.data(), dane.size());
+        }
+        dane.clear();
+    }
+
+    string zabierz() {
+        string wynik;
+        wynik.swap(dane);
+        return wynik;
+    }
+
+  private:
+    static const size_t rozmiar_porcji = 1 << 16;
+    ostream *cel;
+    string dane;
+};
+
+// Liczniki i czasy włączane przez --stats albo --stats-json. Wyłączone kosztują jedno
+// sprawdzenie flagi w każdym punkcie pomiaru. Dane są atomowe, bo zapytania z --threads
+// liczą się równolegle.
+namespace Pomiary {
+bool wlaczone = false;
+
+// histogram[i] - liczba pomiarów krótszych niż 2^i ns (i nie krótszych niż 2^(i - 1) ns)
+class Histogram {
+  public:
+    static const size_t liczba_kubelkow = 64;
+
+    void dodaj(uint64_t ns) {
+        size_t kubelek = 0;
+        while (kubelek + 1 < liczba_kubelkow && (ns >> kubelek) != 0) {
+            kubelek++;
+        }
+        kubelki[kubelek].fetch_add(1, std::memory_order_relaxed);
+        liczba.fetch_add(1, std::memory_order_relaxed);
+        suma.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t poprzednie = maks.load(std::memory_order_relaxed);
+        while (poprzednie < ns && !maks.compare_exchange_weak(poprzednie, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t ile() const { return liczba.load(std::memory_order_relaxed); }
+    uint64_t razem() const { return suma.load(std::memory_order_relaxed); }
+    uint64_t najdluzej() const { return maks.load(std::memory_order_relaxed); }
+    uint64_t kubelek(size_t i) const { return kubelki[i].load(std::memory_order_relaxed); }
+
+    // Górna granica kubełka, w którym wypada dany percentyl.
+    uint64_t percentyl(double p) const {
+        uint64_t prog = static_cast<uint64_t>(p * ile() / 100), dotad = 0;
+        for (size_t i = 0; i < liczba_kubelkow; i++) {
+            dotad += kubelek(i);
+            if (dotad > prog) {
+                return std::min(uint64_t{1} << i, najdluzej());
+            }
+        }
+        return najdluzej();
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, liczba_kubelkow> kubelki{};
+    std::atomic<uint64_t> liczba{0}, suma{0}, maks{0};
+};
+
+enum etap { ROZBIOR, TRASA, BILETY, CENNIK, WYJSCIE, LICZBA_ETAPOW };
+const char *const nazwy_etapow[LICZBA_ETAPOW] = {"parse", "route", "tickets", "catalogue", "output"};
+// w kolejności alternatyw Lekser::polecenie
+const char *const nazwy_polecen[] = {"empty", "ticket", "query", "course", "journey", "departures", "invalid"};
+const size_t liczba_polecen = std::size(nazwy_polecen);
+
+struct zbior_pomiarow {
+    std::array<Histogram, LICZBA_ETAPOW> etapy;
+    std::array<Histogram, liczba_polecen> polecenia; // czas obsługi całej linii
+    std::array<std::atomic<uint64_t>, liczba_polecen> odrzucone{};
+};
+zbior_pomiarow zebrane;
+
+using chwila = std::chrono::steady_clock::time_point;
+
+chwila teraz() { return wlaczone ? std::chrono::steady_clock::now() : chwila{}; }
+
+uint64_t nanosekundOd(chwila poczatek) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - poczatek).count();
+}
 
-ostream &operator<<(ostream &out, const bilet &wynik) {
-    out << (get<NAZWA>(wynik));
-    return out;
+// Mierzy czas od utworzenia do końca zakresu.
+class Stoper {
+  public:
+    explicit Stoper(etap e) : histogram(wlaczone ? &zebrane.etapy[e] : nullptr), poczatek(teraz()) {}
+    Stoper(const Stoper &) = delete;
+    Stoper &operator=(const Stoper &) = delete;
+    ~Stoper() {
+        if (histogram != nullptr) {
+            histogram->dodaj(nanosekundOd(poczatek));
+        }
+    }
+
+  private:
+    Histogram *histogram;
+    chwila poczatek;
+};
+
+void polecenie(size_t rodzaj, chwila poczatek, bool poprawne) {
+    if (!wlaczone) {
+        return;
+    }
+    zebrane.polecenia[rodzaj].dodaj(nanosekundOd(poczatek));
+    if (!poprawne) {
+        zebrane.odrzucone[rodzaj].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void wypisz(ostream &o) {
+    auto czasy = [&](const Histogram &h) {
+        o << "p50 " << h.percentyl(50) << " ns, p99 " << h.percentyl(99) << " ns, max " << h.najdluzej() << " ns\n";
+    };
+    for (size_t i = 0; i < liczba_polecen; i++) {
+        const Histogram &h = zebrane.polecenia[i];
+        o << "lines " << nazwy_polecen[i] << ": " << h.ile() << ", rejected " << zebrane.odrzucone[i] << ", ";
+        czasy(h);
+    }
+    for (size_t i = 0; i < LICZBA_ETAPOW; i++) {
+        const Histogram &h = zebrane.etapy[i];
+        o << "time " << nazwy_etapow[i] << ": " << h.ile() << " calls, " << h.razem() / 1000000.0 << " ms, ";
+        czasy(h);
+    }
+}
+
+void wypiszJson(ostream &o, const Histogram &h) {
+    o << "{\"count\": " << h.ile() << ", \"total_ns\": " << h.razem() << ", \"p50_ns\": " << h.percentyl(50)
+      << ", \"p90_ns\": " << h.percentyl(90) << ", \"p99_ns\": " << h.percentyl(99)
+      << ", \"max_ns\": " << h.najdluzej() << ", \"histogram\": [";
+    size_t ostatni = Histogram::liczba_kubelkow;
+    while (ostatni > 0 && h.kubelek(ostatni - 1) == 0) {
+        ostatni--;
+    }
+    for (size_t i = 0; i < ostatni; i++) {
+        o << (i == 0 ? "" : ", ") << h.kubelek(i);
+    }
+    o << "]}";
 }
 
-ostream &operator<<(ostream &out, __attribute__((unused)) const nie_da_sie_kupic_biletu &e) {
-    out << ":-|\n";
-    return out;
+void wypiszJson(ostream &o) {
+    o << "{\"lines\": {";
+    for (size_t i = 0; i < liczba_polecen; i++) {
+        o << (i == 0 ? "" : ", ") << "\"" << nazwy_polecen[i] << "\": {\"rejected\": " << zebrane.odrzucone[i]
+          << ", \"latency\": ";
+        wypiszJson(o, zebrane.polecenia[i]);
+        o << "}";
+    }
+    o << "}, \"phases\": {";
+    for (size_t i = 0; i < LICZBA_ETAPOW; i++) {
+        o << (i == 0 ? "" : ", ") << "\"" << nazwy_etapow[i] << "\": ";
+        wypiszJson(o, zebrane.etapy[i]);
+    }
+    o << "}}\n";
 }
+} // namespace Pomiary
 
 minuty ileMinutOdPolnocy(const punkt_w_czasie &p) {
     const int ileMinut = 60;
     return p.first * ileMinut + p.second;
 }
 
-void wypiszWynikZapytania(const wynik_zapytania &wynik, size_t &liczba_sprzedanych_biletow) {
-    std::visit(overloaded{[&liczba_sprzedanych_biletow](const zestaw_biletow &zestaw) {
-                              zestaw_biletow nowy;
-                              std::copy_if(begin(zestaw), end(zestaw), std::back_inserter(nowy),
-                                           [](const bilet &b) { return get<CENA>(b) != 0; });
+// Kursy mieszczą się w godzinach pracy, więc żaden przejazd nie trwa dłużej.
+const punkt_w_czasie poczatek_pracy{5, 55};
+const punkt_w_czasie koniec_pracy{21, 21};
+const minuty najdluzszy_przejazd = ileMinutOdPolnocy(koniec_pracy) - ileMinutOdPolnocy(poczatek_pracy);
 
-                              liczba_sprzedanych_biletow += nowy.size();
-                              cout << "! ";
-                              if (nowy.size() > 0) {
-                                  for (auto it = begin(nowy); next(it) != end(nowy); it++) {
-                                      cout << *it << "; ";
-                                  }
-                                  cout << nowy.back();
+id_przystanku wpiszPrzystanek(slownik_przystankow &slownik, string_view nazwa) {
+    auto it = slownik.identyfikatory.find(nazwa);
+    if (it != end(slownik.identyfikatory)) {
+        return it->second;
+    }
+    id_przystanku id = slownik.nazwy.size();
+    slownik.identyfikatory.emplace(slownik.nazwy.emplace_back(nazwa), id);
+    return id;
+}
+
+id_przystanku znajdzPrzystanek(const slownik_przystankow &slownik, string_view nazwa) {
+    auto it = slownik.identyfikatory.find(nazwa);
+    if (it == end(slownik.identyfikatory)) {
+        return nieznany_przystanek;
+    }
+    return it->second;
+}
+
+BuforWyjscia &wypiszGodzine(BuforWyjscia &wyjscie, minuta_dnia m) {
+    const char cyfry[] = "0123456789";
+    char minuta[] = {cyfry[m % 60 / 10], cyfry[m % 10]};
+    return wyjscie << size_t{m / 60u} << ":" << string_view(minuta, 2);
+}
+
+size_t pozycjaPoBilecie(size_t pozycja, minuty czas_waznosci) {
+    return czas_waznosci >= pozycja ? 0 : pozycja - czas_waznosci;
+}
+
+void wypiszBilety(const plan_biletow &plan, const katalog_biletow &katalog, BuforWyjscia &wyjscie,
+                  size_t &liczba_sprzedanych_biletow) {
+    if (plan.cena == brak_zestawu) {
+        wyjscie << ":-|\n";
+        return;
+    }
+    // pusty bilet (cena 0) tylko dopełnia plan do maks_biletow biletów
+    wyjscie << "! ";
+    bool pierwszy = true;
+    size_t pozycja = plan.pozycja;
+    for (size_t m = katalog.maks_biletow; m > 0; m--) {
+        uint32_t i = katalog.warstwy[m][pozycja].bilet;
+        const bilet &b = katalog.bilety[i];
+        pozycja = pozycjaPoBilecie(pozycja, get<CZAS_WAZNOSCI>(b));
+        if (get<CENA>(b) == 0) {
+            continue;
+        }
+        wyjscie << (pierwszy ? "" : "; ") << get<NAZWA>(b);
+        pierwszy = false;
+        liczba_sprzedanych_biletow++;
+    }
+    wyjscie << "\n";
+}
+
+void wypiszWynikZapytania(const wynik_zapytania &wynik, const katalog_biletow &katalog, BuforWyjscia &wyjscie,
+                          size_t &liczba_sprzedanych_biletow) {
+    Pomiary::Stoper pomiar(Pomiary::WYJSCIE);
+    std::visit(overloaded{[&](const plan_biletow &plan) {
+                              wypiszBilety(plan, katalog, wyjscie, liczba_sprzedanych_biletow);
+                          },
+                          [&](const trzeba_czekac &t) { wyjscie << ":-( " << t << "\n"; },
+                          [&](const nie_da_sie_kupic_biletu &) { wyjscie << ":-|\n"; },
+                          [&](const plan_podrozy &podroz) {
+                              wyjscie << ">";
+                              for (size_t i = 0; i < podroz.numeryKursow.size(); i++) {
+                                  wyjscie << " " << podroz.przystanki[i] << " " << podroz.numeryKursow[i];
                               }
-                              cout << "\n";
+                              wyjscie << " " << podroz.przystanki.back() << "\n";
+                              wypiszBilety(podroz.bilety, katalog, wyjscie, liczba_sprzedanych_biletow);
+                          },
+                          [&](const tablica_odjazdow &t) {
+                              wyjscie << "@";
+                              for (const auto &[godzina, numer] : t.odjazdy) {
+                                  wypiszGodzine(wyjscie << " ", godzina) << " " << numer;
+                              }
+                              wyjscie << "\n";
                           },
-                          [](const trzeba_czekac &t) { cout << ":-( " << t << "\n"; },
-                          [](const nie_da_sie_kupic_biletu &e) { cout << e; },
                           [](__attribute__((unused)) const blad &b) {}},
                wynik);
 }
 
-void blednaLinia(const string &linia, size_t numer) { cerr << "Error in line " << numer << ": " << linia << "\n"; }
+void wypiszStatystykiBiletow(const katalog_biletow &katalog) {
+    // bez pustego biletu, który zawsze jest w obu zbiorach
+    size_t wszystkie = katalog.bilety.size() - 1;
+    size_t niezdominowane = katalog.niezdominowane.size() - 1;
+    double odrzucone = wszystkie == 0 ? 0 : 100.0 * (wszystkie - niezdominowane) / wszystkie;
+    cerr << "tickets: " << wszystkie << "\n"
+         << "non-dominated tickets: " << niezdominowane << "\n"
+         << "pruned: " << odrzucone << "%\n";
+}
+
+void wypiszStatystykiTras(const PamiecTras &trasy) {
+    size_t wszystkie = trasy.liczbaTrafien() + trasy.liczbaChybien();
+    double trafione = wszystkie == 0 ? 0 : 100.0 * trasy.liczbaTrafien() / wszystkie;
+    cerr << "route cache hits: " << trasy.liczbaTrafien() << "\n"
+         << "route cache misses: " << trasy.liczbaChybien() << "\n"
+         << "route cache hit rate: " << trafione << "%\n";
+}
+
+template <typename W> void blednaLinia(W &bledy, string_view linia, size_t numer) {
+    Pomiary::Stoper pomiar(Pomiary::WYJSCIE);
+    bledy << "Error in line " << numer << ": " << linia << "\n";
+}
 
-bool dodajBiletDoRozkladu(zestaw_biletow &zestaw, const string &nazwa, uint64_t zlote, uint64_t grosze, minuty m) {
+bool dodajBiletDoRozkladu(zestaw_biletow &zestaw, string_view nazwa, uint64_t zlote, uint64_t grosze, minuty m) {
     cena_grosze c = zlote * 100 + grosze;
     if (c == 0) {
         return false;
     }
-    auto it = std::find_if(begin(zestaw), end(zestaw), [nazwa](auto b) { return get<NAZWA>(b) == nazwa; });
+    auto it = std::find_if(begin(zestaw), end(zestaw), [nazwa](const bilet &b) { return get<NAZWA>(b) == nazwa; });
     if (it == end(zestaw)) {
-        zestaw.emplace_back(nazwa, c, m);
+        zestaw.emplace_back(string{nazwa}, c, m);
         return true;
     }
     return false;
 }
 
-bool dodajKursDoRozkladu(rozklad_kursow &rozklad, numer_kursu numerKursu, const kurs &k) {
-    auto it = rozklad.find(numerKursu);
-    if (it != end(rozklad)) {
+bool dodajKursDoRozkladu(rozklad_kursow &rozklad, numer_kursu numerKursu, kurs &&k) {
+    uint32_t indeks = rozklad.kursy.size();
+    if (!rozklad.indeksy_kursow.emplace(numerKursu, indeks).second) {
         return false;
     }
-    rozklad[numerKursu] = k;
+    siatka_polaczen &siatka = rozklad.siatka;
+    siatka.numery_kursow.push_back(numerKursu);
+    for (size_t i = 0; i + 1 < k.size(); i++) {
+        siatka.nowe_polaczenia.push_back({k[i].second, k[i + 1].second, k[i].first, k[i + 1].first, indeks});
+    }
+    // z ostatniego przystanku kurs już nie odjeżdża
+    for (size_t i = 0; i + 1 < k.size(); i++) {
+        if (k[i].first >= rozklad.odjazdy.size()) {
+            rozklad.odjazdy.resize(k[i].first + 1);
+        }
+        vector<odjazd> &odjazdy = rozklad.odjazdy[k[i].first];
+        odjazd o{k[i].second, numerKursu};
+        odjazdy.insert(std::upper_bound(begin(odjazdy), end(odjazdy), o), o);
+    }
+    rozklad.kursy.push_back(std::move(k));
+    rozklad.pokolenie++;
     return true;
 }
 
-variant<punkt_w_czasie, przystanek, blad> moznaOdjechacZPrzystanku(const kurs &k, const przystanek &startowy,
-                                                                   const przystanek &koncowy,
-                                                                   const punkt_w_czasie &godzinaOdjazdu) {
-    auto itStartowy = k.find(startowy);
-    auto itKoncowy = k.find(koncowy);
+const kurs *znajdzKurs(const rozklad_kursow &rozklad, numer_kursu numerKursu) {
+    auto it = rozklad.indeksy_kursow.find(numerKursu);
+    if (it == end(rozklad.indeksy_kursow)) {
+        return nullptr;
+    }
+    return &rozklad.kursy[it->second];
+}
+
+variant<minuta_dnia, id_przystanku, blad> moznaOdjechacZPrzystanku(const kurs &k, id_przystanku startowy,
+                                                                   id_przystanku koncowy,
+                                                                   minuta_dnia godzinaOdjazdu) {
+    auto itStartowy = end(k), itKoncowy = end(k);
+    for (auto it = begin(k); it != end(k); ++it) {
+        if (it->first == startowy) {
+            itStartowy = it;
+        } else if (it->first == koncowy) {
+            itKoncowy = it;
+        }
+    }
     if (itStartowy == end(k) or itKoncowy == end(k)) {
         return blad{};
     }
@@ -149,208 +593,1964 @@ variant<punkt_w_czasie, przystanek, blad> moznaOdjechacZPrzystanku(const kurs &k
     return itKoncowy->second;
 }
 
-variant<minuty, przystanek, blad> znajdzCzasTrasy(const rozklad_kursow &rozklad, const vector<przystanek> &przystanki,
-                                                  const vector<numer_kursu> &numeryKursow) {
+optional<minuta_dnia> godzinaNaPrzystanku(const kurs &k, id_przystanku przyst) {
+    auto it = std::find_if(begin(k), end(k), [przyst](const postoj &p) { return p.first == przyst; });
+    if (it == end(k)) {
+        return {};
+    }
+    return it->second;
+}
+
+czas_trasy znajdzCzasTrasy(const rozklad_kursow &rozklad, const std::pmr::vector<id_przystanku> &przystanki,
+                           const std::pmr::vector<numer_kursu> &numeryKursow) {
     if (przystanki.size() == 0) {
         return blad{};
     }
     if (przystanki.size() == 1) {
         return minuty{};
     }
-    auto linia = wybierzZMapy(rozklad, numeryKursow.front());
-    if (!linia.has_value()) {
+    auto linia = znajdzKurs(rozklad, numeryKursow.front());
+    if (linia == nullptr) {
         return blad{};
     }
-    auto poczatkowaGodzina = wybierzZMapy(*linia, przystanki.front());
+    auto poczatkowaGodzina = godzinaNaPrzystanku(*linia, przystanki.front());
     if (!poczatkowaGodzina.has_value()) {
         return blad{};
     }
-    punkt_w_czasie godzinaOdjazdu = poczatkowaGodzina.value();
+    minuta_dnia godzinaOdjazdu = poczatkowaGodzina.value();
 
     auto przystankiIt = begin(przystanki);
     auto kursyIt = begin(numeryKursow);
     for (; kursyIt != end(numeryKursow); ++przystankiIt, ++kursyIt) {
-        auto linia = wybierzZMapy(rozklad, *kursyIt);
-        if (!linia.has_value()) {
+        auto linia = znajdzKurs(rozklad, *kursyIt);
+        if (linia == nullptr) {
             return blad{};
         }
         auto mozna = moznaOdjechacZPrzystanku(*linia, *przystankiIt, *next(przystankiIt), godzinaOdjazdu);
 
-        if (std::holds_alternative<punkt_w_czasie>(mozna)) {
-            godzinaOdjazdu = *std::get_if<punkt_w_czasie>(&mozna);
-        } else if (std::holds_alternative<przystanek>(mozna)) {
-            return *std::get_if<przystanek>(&mozna);
+        if (std::holds_alternative<minuta_dnia>(mozna)) {
+            godzinaOdjazdu = *std::get_if<minuta_dnia>(&mozna);
+        } else if (std::holds_alternative<id_przystanku>(mozna)) {
+            return *std::get_if<id_przystanku>(&mozna);
         } else {
             return blad{};
         }
     }
-    return ileMinutOdPolnocy(godzinaOdjazdu) - ileMinutOdPolnocy(poczatkowaGodzina.value());
+    return static_cast<minuty>(godzinaOdjazdu - poczatkowaGodzina.value());
+}
+
+// y dominuje x, jeśli x nie może trafić do żadnego najlepszego planu: y nie jest droższy,
+// jest ważny nie krócej, a przy równej cenie remis i tak rozstrzygnąłby się na korzyść y.
+bool dominuje(const zestaw_biletow &bilety, uint32_t y, uint32_t x) {
+    const bilet &by = bilety[y], &bx = bilety[x];
+    return get<CENA>(by) <= get<CENA>(bx) && get<CZAS_WAZNOSCI>(by) >= get<CZAS_WAZNOSCI>(bx) &&
+           (get<CENA>(by) < get<CENA>(bx) || y > x);
+}
+
+// Zwraca, czy nowy bilet n wszedł do frontu Pareto (i usuwa z niego bilety, które zdominował).
+bool dodajDoFrontu(katalog_biletow &katalog, uint32_t n) {
+    auto &front = katalog.niezdominowane;
+    if (std::any_of(begin(front), end(front), [&](uint32_t y) { return dominuje(katalog.bilety, y, n); })) {
+        return false;
+    }
+    front.erase(std::remove_if(begin(front), end(front), [&](uint32_t x) { return dominuje(katalog.bilety, n, x); }),
+                end(front));
+    front.push_back(n);
+    return true;
+}
+
+// Najlepszy ciąg to najtańszy, a przy równej cenie najpóźniejszy leksykograficznie (tak jak
+// w dawnym przeglądzie wszystkich trójek biletów z porównaniem cena <= najtansza_cena). Taki
+// ciąg ma bilety w kolejności malejących indeksów, a jego reszta jest najlepszym ciągiem
+// krótszym o jeden bilet, więc remis rozstrzyga sam pierwszy bilet.
+bool lepszyPlan(const krok_planu &a, const krok_planu &b) {
+    return a.cena < b.cena || (a.cena == b.cena && a.bilet > b.bilet);
 }
 
-zestaw_biletow znajdzNajtanszyZestawBiletow(const zestaw_biletow &zestaw, minuty czas) {
-    cena_grosze najtansza_cena = std::numeric_limits<cena_grosze>::max();
-    zestaw_biletow wynik{};
-    for (const auto &i : zestaw) {
-        for (const auto &j : zestaw) {
-            for (const auto &k : zestaw) {
-                if (get<CZAS_WAZNOSCI>(i) + get<CZAS_WAZNOSCI>(j) + get<CZAS_WAZNOSCI>(k) > czas) {
-                    auto cena = get<CENA>(i) + get<CENA>(j) + get<CENA>(k);
-                    if (cena <= najtansza_cena) {
-                        najtansza_cena = cena;
-                        wynik = zestaw_biletow{i, j, k};
-                    }
+// Suma cen nasycona tuż poniżej brak_zestawu: zbyt drogi plan nie zawija się do taniego
+// i nie udaje braku zestawu.
+cena_grosze dodajCeny(cena_grosze a, cena_grosze b) {
+    const cena_grosze najwiecej = brak_zestawu - 1;
+    return a > najwiecej - std::min(b, najwiecej) ? najwiecej : a + b;
+}
+
+// Warstwa m powstaje z warstwy m - 1 przez dopisanie biletu na początek ciągu, więc
+// cała tabela kosztuje O(maks_biletow * rozmiar frontu Pareto * najdluzszy_przejazd).
+void przeliczWarstwy(katalog_biletow &katalog) {
+    Pomiary::Stoper pomiar(Pomiary::CENNIK);
+    const size_t rozmiar = najdluzszy_przejazd + 2;
+    katalog.warstwy.resize(katalog.maks_biletow + 1);
+    for (auto &warstwa : katalog.warstwy) {
+        warstwa.assign(rozmiar, krok_planu{});
+    }
+    katalog.warstwy[0][0].cena = 0;
+    for (size_t m = 1; m <= katalog.maks_biletow; m++) {
+        const warstwa_planow &poprzednia = katalog.warstwy[m - 1];
+        warstwa_planow &warstwa = katalog.warstwy[m];
+        for (size_t pozycja = 0; pozycja < rozmiar; pozycja++) {
+            for (uint32_t i : katalog.niezdominowane) {
+                const bilet &b = katalog.bilety[i];
+                const krok_planu &reszta = poprzednia[pozycjaPoBilecie(pozycja, get<CZAS_WAZNOSCI>(b))];
+                if (reszta.cena == brak_zestawu) {
+                    continue;
+                }
+                krok_planu kandydat{dodajCeny(get<CENA>(b), reszta.cena), i};
+                if (lepszyPlan(kandydat, warstwa[pozycja])) {
+                    warstwa[pozycja] = kandydat;
                 }
             }
         }
     }
-    return wynik;
+    katalog.aktualne_warstwy = true;
 }
 
-wynik_zapytania zapytaj(const rozklad_kursow &rozklad, const zestaw_biletow &zestaw,
-                        const vector<przystanek> &przystanki, const vector<numer_kursu> &numeryKursow) {
-    variant<minuty, przystanek, blad> czasPodrozy = znajdzCzasTrasy(rozklad, przystanki, numeryKursow);
+// Nowy bilet n ma największy indeks, więc w najlepszym ciągu, który go zawiera, stoi na
+// początku, a przy równej cenie wygrywa z każdym ciągiem bez niego. Warstwy poprawia się
+// więc po kolei od najkrótszych w O(maks_biletow * najdluzszy_przejazd), niezależnie od
+// liczby biletów w katalogu.
+void dopiszDoWarstw(katalog_biletow &katalog, uint32_t n) {
+    Pomiary::Stoper pomiar(Pomiary::CENNIK);
+    const size_t rozmiar = najdluzszy_przejazd + 2;
+    const cena_grosze cena = get<CENA>(katalog.bilety[n]);
+    const minuty czas_waznosci = get<CZAS_WAZNOSCI>(katalog.bilety[n]);
+    for (size_t m = 1; m <= katalog.maks_biletow; m++) {
+        const warstwa_planow &poprzednia = katalog.warstwy[m - 1];
+        warstwa_planow &warstwa = katalog.warstwy[m];
+        for (size_t pozycja = 0; pozycja < rozmiar; pozycja++) {
+            const krok_planu &reszta = poprzednia[pozycjaPoBilecie(pozycja, czas_waznosci)];
+            if (reszta.cena == brak_zestawu) {
+                continue;
+            }
+            krok_planu kandydat{dodajCeny(cena, reszta.cena), n};
+            if (lepszyPlan(kandydat, warstwa[pozycja])) {
+                warstwa[pozycja] = kandydat;
+            }
+        }
+    }
+}
+
+plan_biletow znajdzNajtanszyZestawBiletow(const katalog_biletow &katalog, minuty czas) {
+    Pomiary::Stoper pomiar(Pomiary::BILETY);
+    if (czas > najdluzszy_przejazd) {
+        return {};
+    }
+    return {katalog.warstwy[katalog.maks_biletow][czas + 1].cena, czas + 1};
+}
+
+wynik_zapytania zapytaj(const rozklad_kursow &rozklad, const katalog_biletow &katalog,
+                        const std::pmr::vector<id_przystanku> &przystanki,
+                        const std::pmr::vector<numer_kursu> &numeryKursow,
+                        PamiecTras *trasy = nullptr) {
+    czas_trasy czasPodrozy = [&] {
+        Pomiary::Stoper pomiar(Pomiary::TRASA);
+        return trasy == nullptr ? znajdzCzasTrasy(rozklad, przystanki, numeryKursow)
+                                : trasy->pobierz(przystanki, numeryKursow, rozklad.pokolenie,
+                                                 [&] { return znajdzCzasTrasy(rozklad, przystanki, numeryKursow); });
+    }();
     if (std::holds_alternative<minuty>(czasPodrozy)) {
-        auto wynik = znajdzNajtanszyZestawBiletow(zestaw, *std::get_if<minuty>(&czasPodrozy));
-        if (wynik.size() == 0) {
+        auto wynik = znajdzNajtanszyZestawBiletow(katalog, *std::get_if<minuty>(&czasPodrozy));
+        if (wynik.cena == brak_zestawu) {
             return nie_da_sie_kupic_biletu{};
         }
         return wynik;
-    } else if (std::holds_alternative<trzeba_czekac>(czasPodrozy)) {
-        return *std::get_if<trzeba_czekac>(&czasPodrozy);
+    } else if (std::holds_alternative<id_przystanku>(czasPodrozy)) {
+        return trzeba_czekac{rozklad.przystanki.nazwy[*std::get_if<id_przystanku>(&czasPodrozy)]};
     }
     return blad{};
 }
 
-namespace Interfejs {
-using std::istringstream;
-
-bool dodajBilet(zestaw_biletow &zestaw, const string &linia) {
-    std::smatch result;
-    regex_search(linia, result, RE::nazwa_biletu);
-    string nazwa;
+// Połączenia o tej samej minucie odjazdu porządkuje przyjazd, a potem numer kursu (w jednym kursie
+// odjazdy się nie powtarzają). Porządek jest pełny, więc nie zależy od tego, kiedy nowe połączenia
+// zostały scalone, a wyszukiwarka, która przy remisie zostaje przy pierwszym przejrzanym połączeniu,
+// w każdym trybie wybiera kurs o najniższym numerze.
+void scalPolaczenia(siatka_polaczen &siatka) {
+    if (siatka.nowe_polaczenia.empty()) {
+        return;
+    }
+    auto wczesniej = [&](const polaczenie &a, const polaczenie &b) {
+        return std::tie(a.odjazd, a.przyjazd, siatka.numery_kursow[a.kurs]) <
+               std::tie(b.odjazd, b.przyjazd, siatka.numery_kursow[b.kurs]);
+    };
+    std::sort(begin(siatka.nowe_polaczenia), end(siatka.nowe_polaczenia), wczesniej);
+    size_t stare = siatka.polaczenia.size();
+    siatka.polaczenia.insert(end(siatka.polaczenia), begin(siatka.nowe_polaczenia), end(siatka.nowe_polaczenia));
+    std::inplace_merge(begin(siatka.polaczenia), begin(siatka.polaczenia) + stare, end(siatka.polaczenia), wczesniej);
+    siatka.nowe_polaczenia.clear();
+}
 
-    uint64_t zlote, grosze;
-    minuty czas;
+// Pamięć robocza wyszukiwarki połączeń, wspólna dla kolejnych zapytań jednego wątku. Przed
+// zapytaniem czyści tylko wpisy, których dotknęło poprzednie, więc po rozgrzaniu wyszukiwanie
+// nie sięga do sterty, dopóki rozkład nie urośnie.
+class PamiecPodrozy {
+  public:
+    struct dojazd {
+        minuta_dnia start;
+        uint32_t kurs;
+        id_przystanku wsiadka;
+        minuta_dnia godzina_wsiadki;
+    };
+    static constexpr minuta_dnia brak = std::numeric_limits<minuta_dnia>::max();
 
-    nazwa = result.str(1);
+    void przygotuj(size_t liczba_kursow) {
+        for (uint32_t kurs : uzyte_kursy) {
+            w_kursie[kurs].start = brak;
+        }
+        uzyte_kursy.clear();
+        if (w_kursie.size() < liczba_kursow) {
+            w_kursie.resize(liczba_kursow, dojazd{brak, 0, 0, 0});
+        }
+        for (uint32_t i : zajete) {
+            wpisy[i].zdarzenie = wolne;
+        }
+        zajete.clear();
+        odcinki.clear();
+    }
 
-    istringstream ss(result.suffix());
+    // Najlepszy dojazd kursem; kurs, który dostał pierwszy start, trzeba zgłosić do czyszczenia.
+    dojazd &kursem(uint32_t kurs) { return w_kursie[kurs]; }
+    void uzytoKursu(uint32_t kurs) { uzyte_kursy.push_back(kurs); }
 
-    ss >> zlote;
-    ss.ignore(1); // kropka dziesiętna
-    ss >> grosze;
-    ss >> czas;
-    if (zlote == std::numeric_limits<decltype(zlote)>::max()) {
-        return false;
+    // Osiągnięte zdarzenia (przystanek, minuta) w tablicy z adresowaniem otwartym.
+    dojazd *znajdz(uint64_t zdarzenie) {
+        if (wpisy.empty()) {
+            return nullptr;
+        }
+        for (size_t i = pozycja(zdarzenie);; i = (i + 1) & (wpisy.size() - 1)) {
+            if (wpisy[i].zdarzenie == zdarzenie) {
+                return &wpisy[i].jazda;
+            }
+            if (wpisy[i].zdarzenie == wolne) {
+                return nullptr;
+            }
+        }
     }
-    if (grosze == std::numeric_limits<decltype(grosze)>::max()) {
-        return false;
+    // Jak try_emplace: zwraca wpis i to, czy jest nowy.
+    pair<dojazd *, bool> wstaw(uint64_t zdarzenie, const dojazd &jazda) {
+        if (2 * (zajete.size() + 1) > wpisy.size()) {
+            powieksz();
+        }
+        size_t i = pozycja(zdarzenie);
+        while (wpisy[i].zdarzenie != wolne && wpisy[i].zdarzenie != zdarzenie) {
+            i = (i + 1) & (wpisy.size() - 1);
+        }
+        if (wpisy[i].zdarzenie == zdarzenie) {
+            return {&wpisy[i].jazda, false};
+        }
+        wpisy[i] = {zdarzenie, jazda};
+        zajete.push_back(static_cast<uint32_t>(i));
+        return {&wpisy[i].jazda, true};
     }
-    if (czas == std::numeric_limits<decltype(czas)>::max()) {
-        return false;
+
+    vector<pair<id_przystanku, numer_kursu>> odcinki;
+
+  private:
+    static constexpr uint64_t wolne = std::numeric_limits<uint64_t>::max();
+    struct wpis {
+        uint64_t zdarzenie;
+        dojazd jazda;
+    };
+
+    size_t pozycja(uint64_t zdarzenie) const { return (zdarzenie * 0x9E3779B97F4A7C15u) >> (64 - bity); }
+
+    void powieksz() {
+        vector<wpis> stare(std::max<size_t>(1024, 2 * wpisy.size()), wpis{wolne, {}});
+        stare.swap(wpisy);
+        bity = 0;
+        while ((size_t{1} << bity) < wpisy.size()) {
+            bity++;
+        }
+        vector<uint32_t> stare_zajete;
+        stare_zajete.swap(zajete);
+        zajete.reserve(stare_zajete.capacity());
+        for (uint32_t i : stare_zajete) {
+            wstaw(stare[i].zdarzenie, stare[i].jazda);
+        }
     }
-    return dodajBiletDoRozkladu(zestaw, nazwa, zlote, grosze, czas);
-}
 
-bool zapytanieOBilety(const rozklad_kursow &rozklad, const zestaw_biletow &zestaw, const string &linia,
-                      size_t &liczba_sprzedanych_biletow) {
-    istringstream ss(linia);
-    ss.ignore(1); // znak zapytania
+    vector<dojazd> w_kursie;
+    vector<uint32_t> uzyte_kursy;
+    vector<wpis> wpisy; // rozmiar jest potęgą dwójki
+    vector<uint32_t> zajete;
+    int bity = 0;
+};
+thread_local PamiecPodrozy pamiec_podrozy;
 
-    vector<przystanek> przystanki;
-    vector<numer_kursu> numeryKursow;
+// Wyszukiwarka połączeń (connection scan) o najwcześniejszym przyjeździe. Tak jak przy zapytaniu
+// o bilety nie wolno czekać na przesiadkę: kolejny kurs musi odjeżdżać o tej samej minucie, o której
+// przyjechał poprzedni. Osiągalne są więc zdarzenia (przystanek, minuta); dla każdego pamiętamy
+// najpóźniejszy odjazd z przystanku początkowego, który do niego prowadzi, bo krótsza podróż jest
+// nie droższa. Wymaga scalonej siatki (scalPolaczenia).
+variant<plan_podrozy, blad> znajdzPodroz(const rozklad_kursow &rozklad, id_przystanku skad, id_przystanku dokad,
+                                         minuta_dnia najwczesniej) {
+    Pomiary::Stoper pomiar(Pomiary::TRASA);
+    if (skad == nieznany_przystanek || dokad == nieznany_przystanek || skad == dokad) {
+        return blad{};
+    }
+    using dojazd = PamiecPodrozy::dojazd;
+    const auto brak = PamiecPodrozy::brak;
+    auto zdarzenie = [](id_przystanku p, minuta_dnia t) { return uint64_t{p} << 16 | t; };
 
-    przystanek p;
-    numer_kursu n;
-    ss >> p;
-    przystanki.emplace_back(p);
+    const siatka_polaczen &siatka = rozklad.siatka;
+    PamiecPodrozy &pamiec = pamiec_podrozy;
+    pamiec.przygotuj(siatka.numery_kursow.size());
+    optional<pair<minuta_dnia, dojazd>> najlepszy; // przyjazd do celu
 
-    while (ss >> n >> p) {
-        numeryKursow.emplace_back(n);
-        przystanki.emplace_back(p);
+    auto it = std::lower_bound(begin(siatka.polaczenia), end(siatka.polaczenia), najwczesniej,
+                               [](const polaczenie &p, minuta_dnia t) { return p.odjazd < t; });
+    for (; it != end(siatka.polaczenia); ++it) {
+        const polaczenie &p = *it;
+        if (najlepszy && p.odjazd >= najlepszy->first) {
+            break;
+        }
+        dojazd &jazda = pamiec.kursem(p.kurs);
+        const bool bez_startu = jazda.start == brak;
+        if (p.skad == skad) {
+            if (jazda.start == brak || jazda.start < p.odjazd) {
+                jazda = {p.odjazd, p.kurs, skad, p.odjazd};
+            }
+        } else if (const dojazd *z = pamiec.znajdz(zdarzenie(p.skad, p.odjazd))) {
+            if (jazda.start == brak || jazda.start < z->start) {
+                jazda = {z->start, p.kurs, p.skad, p.odjazd};
+            }
+        }
+        if (jazda.start == brak) {
+            continue;
+        }
+        if (bez_startu) {
+            pamiec.uzytoKursu(p.kurs);
+        }
+        auto [z, nowe] = pamiec.wstaw(zdarzenie(p.dokad, p.przyjazd), jazda);
+        if (!nowe && z->start < jazda.start) {
+            *z = jazda;
+        }
+        if (p.dokad == dokad && (!najlepszy || najlepszy->first > p.przyjazd ||
+                                 (najlepszy->first == p.przyjazd && najlepszy->second.start < jazda.start))) {
+            najlepszy.emplace(p.przyjazd, jazda);
+        }
+    }
+    if (!najlepszy) {
+        return blad{};
     }
 
-    wynik_zapytania wynik = zapytaj(rozklad, zestaw, przystanki, numeryKursow);
-    if (std::holds_alternative<blad>(wynik)) {
-        return false;
+    // odtwarzanie trasy od końca: każdy odcinek zaczyna się tam, gdzie wsiedliśmy do kursu
+    auto &odcinki = pamiec.odcinki;
+    dojazd d = najlepszy->second;
+    while (true) {
+        odcinki.emplace_back(d.wsiadka, siatka.numery_kursow[d.kurs]);
+        if (d.wsiadka == skad) {
+            break;
+        }
+        d = *pamiec.znajdz(zdarzenie(d.wsiadka, d.godzina_wsiadki));
     }
-    wypiszWynikZapytania(wynik, liczba_sprzedanych_biletow);
-    return true;
+    plan_podrozy podroz;
+    podroz.przystanki.reserve(odcinki.size() + 1);
+    podroz.numeryKursow.reserve(odcinki.size());
+    for (auto o = odcinki.rbegin(); o != odcinki.rend(); ++o) {
+        podroz.przystanki.push_back(rozklad.przystanki.nazwy[o->first]);
+        podroz.numeryKursow.push_back(o->second);
+    }
+    podroz.przystanki.push_back(rozklad.przystanki.nazwy[dokad]);
+    podroz.czas = najlepszy->first - najlepszy->second.start;
+    return podroz;
 }
 
-bool dodajPrzystanekDoKursu(kurs &k, const przystanek &przyst, const punkt_w_czasie &czas) {
-    auto it = k.find(przyst);
-    if (it != end(k)) {
-        return false;
+// Pamięć robocza jednej linii: listy z rozbioru i pomocnicze tablice zapytania trafiają do
+// stałego bufora, który po linii jest zwalniany w całości. Typowa linia w ogóle nie sięga
+// więc do sterty; dopiero bardzo długa przelewa się do niej. Każdy wątek ma własną.
+class PamiecLinii {
+  public:
+    std::pmr::memory_resource *zasob() { return &arena; }
+    void zwolnij() { arena.release(); }
+
+  private:
+    alignas(std::max_align_t) std::byte bufor[1 << 16];
+    std::pmr::monotonic_buffer_resource arena{bufor, sizeof(bufor)};
+};
+thread_local PamiecLinii pamiec_linii;
+
+// Najbliższe odjazdy z przystanku, nie wcześniej niż o danej godzinie.
+vector<odjazd> znajdzOdjazdy(const rozklad_kursow &rozklad, id_przystanku przyst, minuta_dnia od, size_t ile) {
+    Pomiary::Stoper pomiar(Pomiary::TRASA);
+    if (przyst >= rozklad.odjazdy.size()) {
+        return {};
     }
-    k[przyst] = czas;
-    return true;
+    const vector<odjazd> &odjazdy = rozklad.odjazdy[przyst];
+    auto pierwszy = std::lower_bound(begin(odjazdy), end(odjazdy), odjazd{od, 0});
+    auto ostatni = pierwszy + std::min<size_t>(ile, end(odjazdy) - pierwszy);
+    return vector<odjazd>(pierwszy, ostatni);
 }
 
-istream &operator>>(istream &in, punkt_w_czasie &p) {
-    char c;
-    in >> p.first >> c >> p.second;
-    return in;
-}
+// Lekser rozbierający linię w jednym przebiegu; akceptuje dokładnie te linie co wzorce
+//   bilet:      ^([a-zA-Z ]+) (\d+\.\d{2}) ([1-9]\d*)$
+//   zapytanie:  ^\?( [a-zA-Z_\^]+ \d+)+ ([a-zA-Z_\^]+)$
+//   kurs:       ^(\d+)( [1-9]\d?:\d{2} [a-zA-Z_\^]+)+$
+//   podróż:     ^> ([a-zA-Z_\^]+) ([1-9]\d?:\d{2}) ([a-zA-Z_\^]+)$
+//   odjazdy:    ^@ ([a-zA-Z_\^]+) ([1-9]\d?:\d{2}) ([1-9]\d*)$
+// Liczby są wczytywane jak przez operator>> (łącznie z zachowaniem przy przepełnieniu).
+namespace Lekser {
+struct pusta_linia {};
+struct dodanie_biletu {
+    string_view nazwa;
+    uint64_t zlote, grosze;
+    minuty czas;
+};
+// Listy zapytań i kursów leżą w pamięci podanej do rozbierz (zwykle w pamięci linii).
+struct zapytanie {
+    std::pmr::vector<string_view> przystanki;
+    std::pmr::vector<numer_kursu> numeryKursow;
+};
+struct dodanie_kursu {
+    numer_kursu numerKursu;
+    std::pmr::vector<pair<punkt_w_czasie, string_view>> postoje;
+};
+// > przystanek godzina przystanek - najwcześniejszy dojazd przy odjeździe nie wcześniej niż o godzinie
+struct zapytanie_o_podroz {
+    string_view skad;
+    punkt_w_czasie odjazd;
+    string_view dokad;
+};
+// @ przystanek godzina liczba - tyle najbliższych odjazdów z przystanku od tej godziny
+struct zapytanie_o_odjazdy {
+    string_view przystanek;
+    punkt_w_czasie od;
+    size_t ile;
+};
+using polecenie =
+    variant<pusta_linia, dodanie_biletu, zapytanie, dodanie_kursu, zapytanie_o_podroz, zapytanie_o_odjazdy, blad>;
+static_assert(std::variant_size_v<polecenie> == Pomiary::liczba_polecen);
 
-bool dodajKurs(rozklad_kursow &rozklad, const string &linia) {
-    const punkt_w_czasie poczatek_pracy{5, 55};
-    const punkt_w_czasie koniec_pracy{21, 21};
+bool literaNazwyBiletu(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == ' '; }
 
-    istringstream ss(linia);
-    numer_kursu numerKursu;
-    kurs k;
+bool literaPrzystanku(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '^'; }
 
-    ss >> numerKursu;
+bool cyfra(char c) { return c >= '0' && c <= '9'; }
 
-    przystanek przyst;
-    punkt_w_czasie czas, czas_poprzedni{};
-    while (ss >> czas >> przyst) {
-        if (czas.second >= 60)
-            return false;
+class Czytnik {
+  public:
+    explicit Czytnik(string_view linia) : linia(linia) {}
 
-        if (czas < poczatek_pracy || czas > koniec_pracy)
-            return false;
+    bool koniec() const { return pozycja == linia.size(); }
 
-        if (czas_poprzedni >= czas)
+    bool znak(char c) {
+        if (koniec() || linia[pozycja] != c) {
             return false;
+        }
+        pozycja++;
+        return true;
+    }
 
-        if (!dodajPrzystanekDoKursu(k, przyst, czas))
-            return false;
+    template <typename P> string_view slowo(P dozwolony) {
+        size_t poczatek = pozycja;
+        while (!koniec() && dozwolony(linia[pozycja])) {
+            pozycja++;
+        }
+        return linia.substr(poczatek, pozycja - poczatek);
+    }
 
-        czas_poprzedni = czas;
+    string_view przystanek() { return slowo(literaPrzystanku); }
+
+    // Czy następna liczba zaczyna się od cyfry różnej od zera.
+    bool bezZeraWiodacego() const { return !koniec() && linia[pozycja] != '0'; }
+
+    // Jak operator>>: przy przepełnieniu wynikiem jest maksimum typu.
+    template <typename T>
+    std::optional<T> liczba(size_t min_cyfr, size_t maks_cyfr, bool *przepelnienie = nullptr) {
+        string_view cyfry = slowo(cyfra);
+        if (cyfry.size() < min_cyfr || cyfry.size() > maks_cyfr) {
+            return {};
+        }
+        T wynik = 0;
+        bool przepelniona = false;
+        for (char c : cyfry) {
+            T d = c - '0';
+            if (wynik > (std::numeric_limits<T>::max() - d) / 10) {
+                przepelniona = true;
+                wynik = std::numeric_limits<T>::max();
+                break;
+            }
+            wynik = wynik * 10 + d;
+        }
+        if (przepelnienie != nullptr) {
+            *przepelnienie = przepelniona;
+        }
+        return wynik;
     }
 
-    return dodajKursDoRozkladu(rozklad, numerKursu, k);
-}
-} // namespace Interfejs
-} // namespace
+    template <typename T> std::optional<T> liczba(bool *przepelnienie = nullptr) {
+        return liczba<T>(1, string_view::npos, przepelnienie);
+    }
 
-int main() {
-    zestaw_biletow dostepne_bilety{{}};
-    rozklad_kursow rozklad;
-    size_t liczba_sprzedanych_biletow = 0;
+    // Godzina w postaci [1-9]\d?:\d{2}.
+    std::optional<punkt_w_czasie> godzina() {
+        if (!bezZeraWiodacego()) {
+            return {};
+        }
+        auto g = liczba<uint16_t>(1, 2);
+        if (!g || !znak(':')) {
+            return {};
+        }
+        auto m = liczba<uint16_t>(2, 2);
+        if (!m) {
+            return {};
+        }
+        return punkt_w_czasie{*g, *m};
+    }
 
-    string linia;
-    size_t numer_linii = 0;
-    while (getline(std::cin, linia)) {
-        numer_linii++;
+  private:
+    string_view linia;
+    size_t pozycja = 0;
+};
 
-        bool sukces = false;
+polecenie rozbierzBilet(string_view linia) {
+    Czytnik cz(linia);
+    string_view przedrostek = cz.slowo(literaNazwyBiletu);
+    if (przedrostek.size() < 2 || przedrostek.back() != ' ') {
+        return blad{};
+    }
+    auto zlote = cz.liczba<uint64_t>();
+    if (!zlote || !cz.znak('.')) {
+        return blad{};
+    }
+    auto grosze = cz.liczba<uint64_t>(2, 2);
+    if (!grosze || !cz.znak(' ') || !cz.bezZeraWiodacego()) {
+        return blad{};
+    }
+    auto czas = cz.liczba<minuty>();
+    if (!czas || !cz.koniec()) {
+        return blad{};
+    }
+    return dodanie_biletu{przedrostek.substr(0, przedrostek.size() - 1), *zlote, *grosze, *czas};
+}
 
-        if (regex_match(linia, RE::dodaj_bilet)) {
-            sukces = Interfejs::dodajBilet(dostepne_bilety, linia);
-        } else if (regex_match(linia, RE::zapytanie_o_bilety)) {
-            sukces = Interfejs::zapytanieOBilety(rozklad, dostepne_bilety, linia, liczba_sprzedanych_biletow);
-        } else if (regex_match(linia, RE::dodaj_kurs)) {
-            sukces = Interfejs::dodajKurs(rozklad, linia);
-        } else if (linia.length() == 0) {
-            sukces = true;
+polecenie rozbierzZapytanie(string_view linia, std::pmr::memory_resource *pamiec) {
+    Czytnik cz(linia);
+    cz.znak('?');
+    string_view p;
+    if (!cz.znak(' ') || (p = cz.przystanek()).empty()) {
+        return blad{};
+    }
+    zapytanie z{std::pmr::vector<string_view>(pamiec), std::pmr::vector<numer_kursu>(pamiec)};
+    z.przystanki.push_back(p);
+    bool przepelnienie = false;
+    size_t liczba_par = 0;
+    while (!cz.koniec()) {
+        bool za_duzy = false;
+        auto n = cz.znak(' ') ? cz.liczba<numer_kursu>(&za_duzy) : std::nullopt;
+        if (!n || !cz.znak(' ') || (p = cz.przystanek()).empty()) {
+            return blad{};
+        }
+        liczba_par++;
+        // operator>> przerywał wczytywanie par na pierwszym zbyt dużym numerze kursu
+        przepelnienie = przepelnienie || za_duzy;
+        if (!przepelnienie) {
+            z.numeryKursow.push_back(*n);
+            z.przystanki.push_back(p);
         }
+    }
+    if (liczba_par == 0) {
+        return blad{};
+    }
+    return z;
+}
 
-        if (!sukces) {
-            blednaLinia(linia, numer_linii);
+polecenie rozbierzKurs(string_view linia, std::pmr::memory_resource *pamiec) {
+    Czytnik cz(linia);
+    dodanie_kursu k{0, std::pmr::vector<pair<punkt_w_czasie, string_view>>(pamiec)};
+    bool przepelnienie = false;
+    k.numerKursu = *cz.liczba<numer_kursu>(&przepelnienie);
+    if (cz.koniec()) {
+        return blad{};
+    }
+    while (!cz.koniec()) {
+        auto godzina = cz.znak(' ') ? cz.godzina() : std::nullopt;
+        if (!godzina || !cz.znak(' ')) {
+            return blad{};
+        }
+        string_view p = cz.przystanek();
+        if (p.empty()) {
+            return blad{};
         }
+        k.postoje.emplace_back(*godzina, p);
+    }
+    if (przepelnienie) {
+        // operator>> zostawiał wtedy pusty kurs o maksymalnym numerze
+        k.postoje.clear();
+    }
+    return k;
+}
+
+polecenie rozbierzPodroz(string_view linia) {
+    Czytnik cz(linia);
+    cz.znak('>');
+    string_view skad, dokad;
+    if (!cz.znak(' ') || (skad = cz.przystanek()).empty() || !cz.znak(' ')) {
+        return blad{};
+    }
+    auto godzina = cz.godzina();
+    if (!godzina || !cz.znak(' ') || (dokad = cz.przystanek()).empty() || !cz.koniec()) {
+        return blad{};
+    }
+    return zapytanie_o_podroz{skad, *godzina, dokad};
+}
+
+polecenie rozbierzOdjazdy(string_view linia) {
+    Czytnik cz(linia);
+    cz.znak('@');
+    string_view p;
+    if (!cz.znak(' ') || (p = cz.przystanek()).empty() || !cz.znak(' ')) {
+        return blad{};
+    }
+    auto godzina = cz.godzina();
+    if (!godzina || !cz.znak(' ') || !cz.bezZeraWiodacego()) {
+        return blad{};
+    }
+    auto ile = cz.liczba<size_t>();
+    if (!ile || !cz.koniec()) {
+        return blad{};
+    }
+    return zapytanie_o_odjazdy{p, *godzina, *ile};
+}
+
+// Linie kursów i biletów zmieniają stan kasy; wszystkie pozostałe tylko go czytają.
+bool zmieniaStan(string_view linia) { return !linia.empty() && (cyfra(linia[0]) || literaNazwyBiletu(linia[0])); }
+
+polecenie rozbierz(string_view linia, std::pmr::memory_resource *pamiec = std::pmr::get_default_resource()) {
+    Pomiary::Stoper pomiar(Pomiary::ROZBIOR);
+    if (linia.empty()) {
+        return pusta_linia{};
+    }
+    char pierwszy = linia.front();
+    if (pierwszy == '?') {
+        return rozbierzZapytanie(linia, pamiec);
+    }
+    if (pierwszy == '>') {
+        return rozbierzPodroz(linia);
+    }
+    if (pierwszy == '@') {
+        return rozbierzOdjazdy(linia);
+    }
+    if (cyfra(pierwszy)) {
+        return rozbierzKurs(linia, pamiec);
+    }
+    if (literaNazwyBiletu(pierwszy)) {
+        return rozbierzBilet(linia);
+    }
+    return blad{};
+}
+} // namespace Lekser
+
+namespace Interfejs {
+bool dodajBilet(katalog_biletow &katalog, const Lekser::dodanie_biletu &b) {
+    if (b.zlote == std::numeric_limits<decltype(b.zlote)>::max()) {
+        return false;
+    }
+    if (b.grosze == std::numeric_limits<decltype(b.grosze)>::max()) {
+        return false;
+    }
+    if (b.czas == std::numeric_limits<decltype(b.czas)>::max()) {
+        return false;
+    }
+    if (!dodajBiletDoRozkladu(katalog.bilety, b.nazwa, b.zlote, b.grosze, b.czas)) {
+        return false;
+    }
+    // zdominowany bilet nie zmieni żadnego planu; przed pierwszym zapytaniem warstwy
+    // nie są jeszcze policzone i zbuduje je ono od razu
+    if (dodajDoFrontu(katalog, katalog.bilety.size() - 1) && katalog.aktualne_warstwy) {
+        dopiszDoWarstw(katalog, katalog.bilety.size() - 1);
+    }
+    return true;
+}
+
+void przygotujKatalog(katalog_biletow &katalog) {
+    if (!katalog.aktualne_warstwy) {
+        przeliczWarstwy(katalog);
+    }
+}
+
+// Bez pamięci tras tylko czyta rozkład i katalog (z policzonymi warstwami), więc może działać równolegle.
+wynik_zapytania odpowiedz(const rozklad_kursow &rozklad, const katalog_biletow &katalog, const Lekser::zapytanie &z,
+                          PamiecTras *trasy = nullptr) {
+    std::pmr::vector<id_przystanku> przystanki(z.przystanki.get_allocator());
+    przystanki.reserve(z.przystanki.size());
+    for (string_view p : z.przystanki) {
+        przystanki.push_back(znajdzPrzystanek(rozklad.przystanki, p));
+    }
+    return zapytaj(rozklad, katalog, przystanki, z.numeryKursow, trasy);
+}
+
+void przygotujRozklad(rozklad_kursow &rozklad) { scalPolaczenia(rozklad.siatka); }
+
+// Wymaga scalonej siatki połączeń i policzonych warstw; tylko czyta stan.
+wynik_zapytania odpowiedz(const rozklad_kursow &rozklad, const katalog_biletow &katalog,
+                          const Lekser::zapytanie_o_podroz &z) {
+    if (z.odjazd.second >= 60) {
+        return blad{};
+    }
+    auto wynik = znajdzPodroz(rozklad, znajdzPrzystanek(rozklad.przystanki, z.skad),
+                              znajdzPrzystanek(rozklad.przystanki, z.dokad), ileMinutOdPolnocy(z.odjazd));
+    if (std::holds_alternative<blad>(wynik)) {
+        return blad{};
+    }
+    plan_podrozy &podroz = *std::get_if<plan_podrozy>(&wynik);
+    podroz.bilety = znajdzNajtanszyZestawBiletow(katalog, podroz.czas);
+    return std::move(podroz);
+}
+
+wynik_zapytania odpowiedz(const rozklad_kursow &rozklad, const Lekser::zapytanie_o_odjazdy &z) {
+    id_przystanku przyst = znajdzPrzystanek(rozklad.przystanki, z.przystanek);
+    if (z.od.second >= 60 || przyst == nieznany_przystanek) {
+        return blad{};
+    }
+    return tablica_odjazdow{znajdzOdjazdy(rozklad, przyst, ileMinutOdPolnocy(z.od), z.ile)};
+}
+
+// Odpowiedź na linię, która nie zmienia stanu; pusta linia nie ma odpowiedzi, a zmiana
+// stanu jest tu błędem.
+optional<wynik_zapytania> odpowiedzNaLinie(const rozklad_kursow &rozklad, const katalog_biletow &katalog,
+                                           const Lekser::polecenie &polecenie, PamiecTras *trasy = nullptr) {
+    return std::visit(overloaded{[&](const Lekser::zapytanie &z) -> optional<wynik_zapytania> {
+                                     return odpowiedz(rozklad, katalog, z, trasy);
+                                 },
+                                 [&](const Lekser::zapytanie_o_podroz &z) -> optional<wynik_zapytania> {
+                                     return odpowiedz(rozklad, katalog, z);
+                                 },
+                                 [&](const Lekser::zapytanie_o_odjazdy &z) -> optional<wynik_zapytania> {
+                                     return odpowiedz(rozklad, z);
+                                 },
+                                 [](const Lekser::pusta_linia &) -> optional<wynik_zapytania> { return {}; },
+                                 [](const auto &) -> optional<wynik_zapytania> { return blad{}; }},
+                      polecenie);
+}
+
+bool zapytanieOOdjazdy(const rozklad_kursow &rozklad, const katalog_biletow &katalog,
+                       const Lekser::zapytanie_o_odjazdy &z, BuforWyjscia &wyjscie,
+                       size_t &liczba_sprzedanych_biletow) {
+    wynik_zapytania wynik = odpowiedz(rozklad, z);
+    if (std::holds_alternative<blad>(wynik)) {
+        return false;
+    }
+    wypiszWynikZapytania(wynik, katalog, wyjscie, liczba_sprzedanych_biletow);
+    return true;
+}
+
+bool zapytanieOPodroz(rozklad_kursow &rozklad, katalog_biletow &katalog, const Lekser::zapytanie_o_podroz &z,
+                      BuforWyjscia &wyjscie, size_t &liczba_sprzedanych_biletow) {
+    przygotujKatalog(katalog);
+    przygotujRozklad(rozklad);
+    wynik_zapytania wynik = odpowiedz(rozklad, katalog, z);
+    if (std::holds_alternative<blad>(wynik)) {
+        return false;
+    }
+    wypiszWynikZapytania(wynik, katalog, wyjscie, liczba_sprzedanych_biletow);
+    return true;
+}
+
+bool zapytanieOBilety(const rozklad_kursow &rozklad, katalog_biletow &katalog, PamiecTras &trasy,
+                      const Lekser::zapytanie &z, BuforWyjscia &wyjscie, size_t &liczba_sprzedanych_biletow) {
+    przygotujKatalog(katalog);
+    wynik_zapytania wynik = odpowiedz(rozklad, katalog, z, &trasy);
+    if (std::holds_alternative<blad>(wynik)) {
+        return false;
+    }
+    wypiszWynikZapytania(wynik, katalog, wyjscie, liczba_sprzedanych_biletow);
+    return true;
+}
+
+bool dodajPrzystanekDoKursu(kurs &k, id_przystanku przyst, const punkt_w_czasie &czas) {
+    auto it = std::find_if(begin(k), end(k), [przyst](const postoj &p) { return p.first == przyst; });
+    if (it != end(k)) {
+        return false;
+    }
+    k.emplace_back(przyst, ileMinutOdPolnocy(czas));
+    return true;
+}
+
+// Sprawdza postoje kursu i wpisuje je do k; nazwy przystanków trafiają do słownika
+// nawet wtedy, gdy kurs okaże się błędny.
+bool zbudujKurs(slownik_przystankow &przystanki, const Lekser::dodanie_kursu &polecenie, kurs &k) {
+    k.reserve(polecenie.postoje.size());
+    punkt_w_czasie czas_poprzedni{};
+    for (const auto &[czas, przyst] : polecenie.postoje) {
+        if (czas.second >= 60)
+            return false;
+
+        if (czas < poczatek_pracy || czas > koniec_pracy)
+            return false;
+
+        if (czas_poprzedni >= czas)
+            return false;
+
+        if (!dodajPrzystanekDoKursu(k, wpiszPrzystanek(przystanki, przyst), czas))
+            return false;
+
+        czas_poprzedni = czas;
+    }
+    return true;
+}
+
+bool dodajKurs(rozklad_kursow &rozklad, const Lekser::dodanie_kursu &polecenie) {
+    kurs k;
+    return zbudujKurs(rozklad.przystanki, polecenie, k) &&
+           dodajKursDoRozkladu(rozklad, polecenie.numerKursu, std::move(k));
+}
+
+bool wykonaj(stan_kasy &stan, const Lekser::polecenie &polecenie, BuforWyjscia &wyjscie) {
+    return std::visit(overloaded{[](const Lekser::pusta_linia &) { return true; },
+                                 [&](const Lekser::dodanie_biletu &b) { return dodajBilet(stan.bilety, b); },
+                                 [&](const Lekser::zapytanie &z) {
+                                     return zapytanieOBilety(stan.rozklad, stan.bilety, stan.trasy, z, wyjscie,
+                                                             stan.liczba_sprzedanych_biletow);
+                                 },
+                                 [&](const Lekser::dodanie_kursu &k) { return dodajKurs(stan.rozklad, k); },
+                                 [&](const Lekser::zapytanie_o_podroz &z) {
+                                     return zapytanieOPodroz(stan.rozklad, stan.bilety, z, wyjscie,
+                                                             stan.liczba_sprzedanych_biletow);
+                                 },
+                                 [&](const Lekser::zapytanie_o_odjazdy &z) {
+                                     return zapytanieOOdjazdy(stan.rozklad, stan.bilety, z, wyjscie,
+                                                              stan.liczba_sprzedanych_biletow);
+                                 },
+                                 [](const blad &) { return false; }},
+                      polecenie);
+}
+
+// Rozbiera i wykonuje linię w pamięci linii bieżącego wątku.
+bool wykonajLinie(stan_kasy &stan, string_view linia, BuforWyjscia &wyjscie) {
+    Pomiary::chwila poczatek = Pomiary::teraz();
+    size_t rodzaj;
+    bool poprawne;
+    {
+        Lekser::polecenie polecenie = Lekser::rozbierz(linia, pamiec_linii.zasob());
+        rodzaj = polecenie.index();
+        poprawne = wykonaj(stan, polecenie, wyjscie);
+    }
+    pamiec_linii.zwolnij();
+    Pomiary::polecenie(rodzaj, poczatek, poprawne);
+    return poprawne;
+}
+} // namespace Interfejs
+} // namespace
+
+namespace Rownolegle {
+class PulaWatkow {
+  public:
+    explicit PulaWatkow(size_t liczba_watkow) {
+        for (size_t i = 1; i < liczba_watkow; i++) {
+            watki.emplace_back([this] { pracuj(); });
+        }
+    }
+    PulaWatkow(const PulaWatkow &) = delete;
+    PulaWatkow &operator=(const PulaWatkow &) = delete;
+    ~PulaWatkow() {
+        {
+            std::lock_guard<std::mutex> blokada(mutex);
+            koniec = true;
+        }
+        nowe_zadanie.notify_all();
+        for (auto &w : watki) {
+            w.join();
+        }
+    }
+
+    // Wywołuje f(i) dla każdego i z [0, n) na wszystkich wątkach puli (i wywołującym) i czeka na koniec.
+    // Wątki biorą po porcji kolejnych i; przy niewielu długich zadaniach porcja powinna wynosić 1.
+    void dlaKazdego(size_t n, const std::function<void(size_t)> &f, size_t porcja = 16) {
+        {
+            std::lock_guard<std::mutex> blokada(mutex);
+            zadanie = &f;
+            rozmiar = n;
+            this->porcja = porcja;
+            nastepny = 0;
+            pracujacy = watki.size();
+            runda++;
+        }
+        nowe_zadanie.notify_all();
+        wykonuj(f, n, porcja);
+        std::unique_lock<std::mutex> blokada(mutex);
+        zadanie_skonczone.wait(blokada, [this] { return pracujacy == 0; });
+    }
+
+  private:
+    void wykonuj(const std::function<void(size_t)> &f, size_t n, size_t porcja) {
+        for (size_t i; (i = nastepny.fetch_add(porcja)) < n;) {
+            for (size_t j = i; j < std::min(i + porcja, n); j++) {
+                f(j);
+            }
+        }
+    }
+
+    void pracuj() {
+        size_t ostatnia_runda = 0;
+        while (true) {
+            const std::function<void(size_t)> *f;
+            size_t n, porcja;
+            {
+                std::unique_lock<std::mutex> blokada(mutex);
+                nowe_zadanie.wait(blokada, [&] { return koniec || runda != ostatnia_runda; });
+                if (koniec) {
+                    return;
+                }
+                ostatnia_runda = runda;
+                f = zadanie;
+                n = rozmiar;
+                porcja = this->porcja;
+            }
+            wykonuj(*f, n, porcja);
+            std::lock_guard<std::mutex> blokada(mutex);
+            if (--pracujacy == 0) {
+                zadanie_skonczone.notify_one();
+            }
+        }
+    }
+
+    vector<std::thread> watki;
+    std::mutex mutex;
+    std::condition_variable nowe_zadanie, zadanie_skonczone;
+    const std::function<void(size_t)> *zadanie = nullptr;
+    size_t rozmiar = 0, porcja = 1, pracujacy = 0, runda = 0;
+    std::atomic<size_t> nastepny{0};
+    bool koniec = false;
+};
+
+// Ciąg linii między kolejnymi zmianami rozkładu albo cennika. Żadna z nich nie zmienia stanu,
+// więc rozbiór i odpowiedzi liczą się równolegle, a wypisywane są potem w kolejności wejścia.
+class Partia {
+  public:
+    static const size_t maks_linii = 4096;
+
+    void dodaj(size_t numer_linii, string_view linia) {
+        linie.push_back({numer_linii, tekst.size(), linia.size()});
+        tekst.append(linia);
+    }
+
+    bool pusta() const { return linie.empty(); }
+    bool pelna() const { return linie.size() >= maks_linii; }
+
+    void wykonaj(const rozklad_kursow &rozklad, const katalog_biletow &katalog, PulaWatkow &pula,
+                 BuforWyjscia &wyjscie, size_t &liczba_sprzedanych_biletow) {
+        // pusta linia nie ma wyniku
+        wyniki.assign(linie.size(), std::nullopt);
+        pula.dlaKazdego(linie.size(), [&](size_t i) {
+            Pomiary::chwila poczatek = Pomiary::teraz();
+            Lekser::polecenie polecenie = Lekser::rozbierz(linia(i), pamiec_linii.zasob());
+            wyniki[i] = Interfejs::odpowiedzNaLinie(rozklad, katalog, polecenie);
+            Pomiary::polecenie(polecenie.index(), poczatek,
+                               !wyniki[i].has_value() || !std::holds_alternative<blad>(*wyniki[i]));
+            polecenie = Lekser::pusta_linia{};
+            pamiec_linii.zwolnij();
+        });
+        for (size_t i = 0; i < linie.size(); i++) {
+            if (!wyniki[i].has_value()) {
+                continue;
+            }
+            if (std::holds_alternative<blad>(*wyniki[i])) {
+                blednaLinia(cerr, linia(i), linie[i].numer);
+            } else {
+                wypiszWynikZapytania(*wyniki[i], katalog, wyjscie, liczba_sprzedanych_biletow);
+            }
+        }
+        linie.clear();
+        tekst.clear();
+    }
+
+  private:
+    struct linia_partii {
+        size_t numer, poczatek, dlugosc;
+    };
+
+    string_view linia(size_t i) const { return string_view(tekst).substr(linie[i].poczatek, linie[i].dlugosc); }
+
+    vector<linia_partii> linie;
+    string tekst;
+    vector<optional<wynik_zapytania>> wyniki;
+};
+} // namespace Rownolegle
+
+// Wczytywanie z rozbiorem, wykonywanie poleceń i wypisywanie działają w osobnych wątkach
+// połączonych kolejkami bez blokad. Przesyłane są paczki linii, a ograniczona pojemność
+// kolejek wstrzymuje szybszy etap, zanim zużyje zbyt dużo pamięci.
+namespace Potok {
+// Kolejka jednego producenta i jednego konsumenta na buforze cyklicznym.
+template <typename T, size_t Pojemnosc> class KolejkaSPSC {
+  public:
+    bool wstaw(T &element) {
+        size_t ogon = koniec.load(std::memory_order_relaxed);
+        if (ogon - poczatek.load(std::memory_order_acquire) == Pojemnosc) {
+            return false;
+        }
+        elementy[ogon % Pojemnosc] = std::move(element);
+        koniec.store(ogon + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool zdejmij(T &element) {
+        size_t glowa = poczatek.load(std::memory_order_relaxed);
+        if (glowa == koniec.load(std::memory_order_acquire)) {
+            return false;
+        }
+        element = std::move(elementy[glowa % Pojemnosc]);
+        poczatek.store(glowa + 1, std::memory_order_release);
+        return true;
+    }
+
+    void wstawCzekajac(T &&element) {
+        czekaj([&] { return wstaw(element); });
+        obudz();
+    }
+
+    T zdejmijCzekajac() {
+        T element;
+        czekaj([&] { return zdejmij(element); });
+        obudz();
+        return element;
+    }
+
+  private:
+    static const size_t prob_przed_uspieniem = 64;
+
+    // Po kilku nieudanych próbach wątek zasypia, zamiast zajmować procesor, gdy druga strona
+    // długo nic nie robi (np. czytanie czeka na wejście). Mutex jest używany tylko wtedy, gdy ktoś śpi.
+    template <typename P> void czekaj(P udalo_sie) {
+        for (size_t proba = 0; !udalo_sie(); proba++) {
+            if (proba < prob_przed_uspieniem) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> blokada(mutex);
+            spiacy.fetch_add(1);
+            // razem z barierą w obudz: albo ta próba widzi zmianę, albo budzący widzi śpiącego
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool udalo = udalo_sie();
+            if (!udalo) {
+                zmiana.wait(blokada);
+            }
+            spiacy.fetch_sub(1);
+            if (udalo) {
+                return;
+            }
+        }
+    }
+
+    void obudz() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (spiacy.load() > 0) {
+            std::lock_guard<std::mutex> blokada(mutex);
+            zmiana.notify_all();
+        }
+    }
+
+    std::array<T, Pojemnosc> elementy;
+    alignas(64) std::atomic<size_t> poczatek{0};
+    alignas(64) std::atomic<size_t> koniec{0};
+    alignas(64) std::atomic<size_t> spiacy{0};
+    std::mutex mutex;
+    std::condition_variable zmiana;
+};
+
+struct linia_paczki {
+    size_t numer, poczatek, dlugosc;
+};
+
+// Widoki w poleceniach wskazują na tekst; przeniesienie wektora nie zmienia jego bufora.
+struct paczka_polecen {
+    vector<char> tekst;
+    vector<linia_paczki> linie;
+    vector<Lekser::polecenie> polecenia;
+    bool ostatnia = false;
+
+    string_view linia(size_t i) const { return string_view(tekst.data() + linie[i].poczatek, linie[i].dlugosc); }
+};
+
+struct paczka_wyjscia {
+    string wyjscie, bledy;
+    bool ostatnia = false;
+};
+
+const size_t linii_w_paczce = 256;
+const size_t pojemnosc_kolejki = 64;
+
+template <typename Czytaj> void uruchom(stan_kasy &stan, Czytaj czytaj) {
+    KolejkaSPSC<paczka_polecen, pojemnosc_kolejki> polecenia;
+    KolejkaSPSC<paczka_wyjscia, pojemnosc_kolejki> wyniki;
+
+    std::thread wykonawca([&] {
+        BuforWyjscia wyjscie, bledy;
+        bool ostatnia = false;
+        while (!ostatnia) {
+            paczka_polecen paczka = polecenia.zdejmijCzekajac();
+            for (size_t i = 0; i < paczka.polecenia.size(); i++) {
+                // rozbiór liczy się w wątku czytającym, tu tylko wykonanie
+                Pomiary::chwila poczatek = Pomiary::teraz();
+                bool poprawne = Interfejs::wykonaj(stan, paczka.polecenia[i], wyjscie);
+                Pomiary::polecenie(paczka.polecenia[i].index(), poczatek, poprawne);
+                if (!poprawne) {
+                    blednaLinia(bledy, paczka.linia(i), paczka.linie[i].numer);
+                }
+            }
+            ostatnia = paczka.ostatnia;
+            wyniki.wstawCzekajac({wyjscie.zabierz(), bledy.zabierz(), ostatnia});
+        }
+    });
+    std::thread pisarz([&] {
+        bool ostatnia = false;
+        while (!ostatnia) {
+            paczka_wyjscia paczka = wyniki.zdejmijCzekajac();
+            cout.write(paczka.wyjscie.data(), paczka.wyjscie.size());
+            cerr.write(paczka.bledy.data(), paczka.bledy.size());
+            ostatnia = paczka.ostatnia;
+        }
+    });
+
+    paczka_polecen biezaca;
+    size_t numer_linii = 0;
+    auto wyslij = [&](bool ostatnia) {
+        for (size_t i = 0; i < biezaca.linie.size(); i++) {
+            biezaca.polecenia.push_back(Lekser::rozbierz(biezaca.linia(i)));
+        }
+        biezaca.ostatnia = ostatnia;
+        polecenia.wstawCzekajac(std::move(biezaca));
+        biezaca = {};
+    };
+    czytaj([&](string_view linia) {
+        biezaca.linie.push_back({++numer_linii, biezaca.tekst.size(), linia.size()});
+        biezaca.tekst.insert(end(biezaca.tekst), begin(linia), end(linia));
+        if (biezaca.linie.size() == linii_w_paczce) {
+            wyslij(false);
+        }
+    });
+    wyslij(true);
+
+    wykonawca.join();
+    pisarz.join();
+}
+} // namespace Potok
+
+namespace Wejscie {
+// Plik zmapowany w pamięć; linie są widokami na mapowanie, więc nic nie jest kopiowane,
+// dopóki nazwa przystanku albo biletu nie trafi do słownika.
+class MapowanyPlik {
+  public:
+    explicit MapowanyPlik(const char *sciezka) {
+        int fd = open(sciezka, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat informacje;
+        if (fstat(fd, &informacje) == 0) {
+            rozmiar = informacje.st_size;
+            if (rozmiar == 0) {
+                poprawny = true;
+            } else {
+                void *adres = mmap(nullptr, rozmiar, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (adres != MAP_FAILED) {
+                    dane = static_cast<const char *>(adres);
+                    poprawny = true;
+                    madvise(adres, rozmiar, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+    }
+    MapowanyPlik(const MapowanyPlik &) = delete;
+    MapowanyPlik &operator=(const MapowanyPlik &) = delete;
+    ~MapowanyPlik() {
+        if (dane != nullptr) {
+            munmap(const_cast<char *>(dane), rozmiar);
+        }
+    }
+
+    bool otwarty() const { return poprawny; }
+    string_view zawartosc() const { return {dane, rozmiar}; }
+
+  private:
+    const char *dane = nullptr;
+    size_t rozmiar = 0;
+    bool poprawny = false;
+};
+
+// Linie tak jak z getline: ostatnia nie musi kończyć się znakiem nowej linii.
+template <typename F> void dlaKazdejLinii(string_view dane, F f) {
+    while (!dane.empty()) {
+        size_t koniec = dane.find('\n');
+        if (koniec == string_view::npos) {
+            f(dane);
+            return;
+        }
+        f(dane.substr(0, koniec));
+        dane.remove_prefix(koniec + 1);
+    }
+}
+
+template <typename F> void dlaKazdejLinii(std::istream &in, F f) {
+    string linia;
+    while (getline(in, linia)) {
+        f(string_view{linia});
+    }
+}
+} // namespace Wejscie
+
+// Wykonuje linie po kolei w jednym wątku, a z liczba_watkow > 0 zbiera kolejne zapytania
+// w partie liczone na puli wątków. Błędy trafiają na cerr.
+template <typename Czytaj>
+void wykonajWejscie(stan_kasy &stan, size_t liczba_watkow, BuforWyjscia &wyjscie, Czytaj czytaj) {
+    std::optional<Rownolegle::PulaWatkow> pula;
+    Rownolegle::Partia partia;
+    if (liczba_watkow > 0) {
+        pula.emplace(liczba_watkow);
+    }
+    auto wykonajPartie = [&] {
+        if (partia.pusta()) {
+            return;
+        }
+        Interfejs::przygotujKatalog(stan.bilety);
+        Interfejs::przygotujRozklad(stan.rozklad);
+        partia.wykonaj(stan.rozklad, stan.bilety, *pula, wyjscie, stan.liczba_sprzedanych_biletow);
+    };
+
+    size_t numer_linii = 0;
+    czytaj([&](string_view linia) {
+        numer_linii++;
+
+        if (pula) {
+            if (!Lekser::zmieniaStan(linia)) {
+                partia.dodaj(numer_linii, linia);
+                if (partia.pelna()) {
+                    wykonajPartie();
+                }
+                return;
+            }
+            wykonajPartie();
+        }
+
+        if (!Interfejs::wykonajLinie(stan, linia, wyjscie)) {
+            blednaLinia(cerr, linia, numer_linii);
+        }
+    });
+    if (pula) {
+        wykonajPartie();
+    }
+}
+
+// Pliki rozkładu z samymi kursami (np. po jednym na linię) są rozbierane i sprawdzane
+// równolegle na puli co najwyżej tylu wątków, ile jest rdzeni, każdy z własnym słownikiem
+// przystanków. Potem są po kolei scalane z rozkładem, więc wynik i błędy są takie, jak przy
+// wczytaniu ich jeden po drugim.
+namespace Scalanie {
+struct linia_pliku {
+    size_t numer;
+    string_view tekst;
+};
+
+struct wczytany_plik {
+    slownik_przystankow przystanki;
+    vector<pair<numer_kursu, kurs>> kursy;
+    vector<linia_pliku> zrodla; // linia, z której pochodzi każdy kurs
+    vector<linia_pliku> bledy;
+};
+
+// Poza kursami w pliku rozkładu mogą być tylko puste linie.
+void wczytaj(string_view dane, wczytany_plik &plik) {
+    std::unordered_set<numer_kursu> numery;
+    size_t numer_linii = 0;
+    Wejscie::dlaKazdejLinii(dane, [&](string_view linia) {
+        numer_linii++;
+        Pomiary::chwila poczatek = Pomiary::teraz();
+        size_t rodzaj;
+        bool poprawne;
+        {
+            Lekser::polecenie polecenie = Lekser::rozbierz(linia, pamiec_linii.zasob());
+            rodzaj = polecenie.index();
+            poprawne = std::holds_alternative<Lekser::pusta_linia>(polecenie);
+            if (const auto *k = std::get_if<Lekser::dodanie_kursu>(&polecenie)) {
+                kurs nowy;
+                poprawne = Interfejs::zbudujKurs(plik.przystanki, *k, nowy) && numery.insert(k->numerKursu).second;
+                if (poprawne) {
+                    plik.kursy.emplace_back(k->numerKursu, std::move(nowy));
+                    plik.zrodla.push_back({numer_linii, linia});
+                }
+            }
+        }
+        pamiec_linii.zwolnij();
+        Pomiary::polecenie(rodzaj, poczatek, poprawne);
+        if (!poprawne) {
+            plik.bledy.push_back({numer_linii, linia});
+        }
+    });
+}
+
+// Kurs o numerze, który już jest w rozkładzie, to błąd w linii późniejszego pliku.
+void scal(rozklad_kursow &rozklad, wczytany_plik &plik) {
+    // wszystkie nazwy w kolejności z pliku, tak jak przy wykonywaniu linii po kolei
+    vector<id_przystanku> nowe_id(plik.przystanki.nazwy.size());
+    for (id_przystanku id = 0; id < nowe_id.size(); id++) {
+        nowe_id[id] = wpiszPrzystanek(rozklad.przystanki, plik.przystanki.nazwy[id]);
+    }
+    for (size_t i = 0; i < plik.kursy.size(); i++) {
+        auto &[numer, k] = plik.kursy[i];
+        for (postoj &p : k) {
+            p.first = nowe_id[p.first];
+        }
+        if (!dodajKursDoRozkladu(rozklad, numer, std::move(k))) {
+            plik.bledy.push_back(plik.zrodla[i]);
+        }
+    }
+    std::sort(begin(plik.bledy), end(plik.bledy),
+              [](const linia_pliku &a, const linia_pliku &b) { return a.numer < b.numer; });
+}
+
+// Zwraca false, gdy któregoś pliku nie da się przeczytać; wtedy rozkład się nie zmienia.
+bool wczytajPliki(rozklad_kursow &rozklad, const vector<const char *> &sciezki) {
+    vector<std::unique_ptr<Wejscie::MapowanyPlik>> mapowania;
+    for (const char *sciezka : sciezki) {
+        mapowania.push_back(std::make_unique<Wejscie::MapowanyPlik>(sciezka));
+        if (!mapowania.back()->otwarty()) {
+            cerr << "Cannot read " << sciezka << ": " << std::strerror(errno) << "\n";
+            return false;
+        }
+    }
+    vector<wczytany_plik> pliki(sciezki.size());
+    size_t liczba_watkow = std::min<size_t>(sciezki.size(), std::max(1u, std::thread::hardware_concurrency()));
+    Rownolegle::PulaWatkow pula(liczba_watkow);
+    pula.dlaKazdego(
+        sciezki.size(), [&](size_t i) { wczytaj(mapowania[i]->zawartosc(), pliki[i]); }, 1);
+
+    BuforWyjscia bledy(&cerr);
+    for (size_t i = 0; i < sciezki.size(); i++) {
+        scal(rozklad, pliki[i]);
+        for (const linia_pliku &l : pliki[i].bledy) {
+            Pomiary::Stoper pomiar(Pomiary::WYJSCIE);
+            bledy << "Error in line " << l.numer << " of " << sciezki[i] << ": " << l.tekst << "\n";
+        }
+    }
+    bledy.oproznij();
+    return true;
+}
+} // namespace Scalanie
+
+// Binarny zrzut rozkładu, słownika przystanków i katalogu biletów. Wczytanie zrzutu pomija
+// rozbiór i sprawdzanie linii tekstu; struktury pochodne (front Pareto, warstwy planów)
+// są odtwarzane na miejscu. Liczby zapisywane są w porządku bajtów maszyny.
+namespace Zrzut {
+const char sygnatura[8] = {'K', 'A', 'S', 'A', 'S', 'N', 'A', 'P'};
+const uint32_t wersja = 1;
+const uint32_t znacznik_porzadku = 0x01020304;
+
+class Pisarz {
+  public:
+    explicit Pisarz(std::ostream &out) : out(out) {}
+
+    template <typename T> void pisz(const T &wartosc) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.write(reinterpret_cast<const char *>(&wartosc), sizeof(wartosc));
+    }
+
+    void piszTekst(string_view tekst) {
+        pisz<uint32_t>(tekst.size());
+        out.write(tekst.data(), tekst.size());
+    }
+
+  private:
+    std::ostream &out;
+};
+
+class Czytelnik {
+  public:
+    explicit Czytelnik(string_view dane) : dane(dane) {}
+
+    template <typename T> bool czytaj(T &wartosc) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (dane.size() < sizeof(wartosc)) {
+            return false;
+        }
+        std::memcpy(&wartosc, dane.data(), sizeof(wartosc));
+        dane.remove_prefix(sizeof(wartosc));
+        return true;
+    }
+
+    bool czytajTekst(string_view &tekst) {
+        uint32_t dlugosc;
+        if (!czytaj(dlugosc) || dane.size() < dlugosc) {
+            return false;
+        }
+        tekst = dane.substr(0, dlugosc);
+        dane.remove_prefix(dlugosc);
+        return true;
+    }
+
+    bool koniec() const { return dane.empty(); }
+
+    // Czy w pozostałych danych zmieści się liczba elementów, z których każdy zajmuje
+    // co najmniej rozmiar bajtów; sprawdzane przed przydziałem pamięci na podstawie liczby z pliku.
+    bool miesci(uint64_t liczba, size_t rozmiar) const { return liczba <= dane.size() / rozmiar; }
+
+  private:
+    string_view dane;
+};
+
+bool zapisz(const stan_kasy &stan, const char *sciezka) {
+    std::ofstream plik(sciezka, std::ios::binary | std::ios::trunc);
+    Pisarz p(plik);
+    plik.write(sygnatura, sizeof(sygnatura));
+    p.pisz(wersja);
+    p.pisz(znacznik_porzadku);
+
+    const slownik_przystankow &przystanki = stan.rozklad.przystanki;
+    p.pisz<uint64_t>(przystanki.nazwy.size());
+    for (const przystanek &nazwa : przystanki.nazwy) {
+        p.piszTekst(nazwa);
+    }
+
+    // bez pustego biletu, który ma każdy katalog
+    const zestaw_biletow &bilety = stan.bilety.bilety;
+    p.pisz<uint64_t>(bilety.size() - 1);
+    for (auto it = next(begin(bilety)); it != end(bilety); ++it) {
+        p.piszTekst(get<NAZWA>(*it));
+        p.pisz(get<CENA>(*it));
+        p.pisz(get<CZAS_WAZNOSCI>(*it));
+    }
+
+    // w kolejności dodania, więc po wczytaniu kursy mają te same gęste indeksy
+    const rozklad_kursow &rozklad = stan.rozklad;
+    p.pisz<uint64_t>(rozklad.kursy.size());
+    for (uint32_t indeks = 0; indeks < rozklad.kursy.size(); indeks++) {
+        const kurs &k = rozklad.kursy[indeks];
+        p.pisz(rozklad.siatka.numery_kursow[indeks]);
+        p.pisz<uint32_t>(k.size());
+        for (const postoj &postoj : k) {
+            p.pisz(postoj.first);
+            p.pisz(postoj.second);
+        }
+    }
+    plik.flush();
+    return static_cast<bool>(plik);
+}
+
+// Wczytuje zrzut do pustego stanu; przy błędzie stan jest nieokreślony. Bilety i kursy przechodzą
+// te same sprawdzenia co w dodajBilet i dodajKurs, więc uszkodzony plik nie wpuści do stanu niczego,
+// czego nie dałoby się dodać z wejścia.
+bool wczytaj(stan_kasy &stan, string_view dane) {
+    Czytelnik cz(dane);
+    char naglowek[sizeof(sygnatura)];
+    uint32_t wersja_pliku, porzadek;
+    for (char &c : naglowek) {
+        if (!cz.czytaj(c)) {
+            return false;
+        }
+    }
+    if (!std::equal(begin(naglowek), end(naglowek), begin(sygnatura)) || !cz.czytaj(wersja_pliku) ||
+        wersja_pliku != wersja || !cz.czytaj(porzadek) || porzadek != znacznik_porzadku) {
+        return false;
+    }
+
+    uint64_t liczba;
+    if (!cz.czytaj(liczba) || !cz.miesci(liczba, sizeof(uint32_t))) {
+        return false;
+    }
+    slownik_przystankow &przystanki = stan.rozklad.przystanki;
+    for (uint64_t i = 0; i < liczba; i++) {
+        string_view nazwa;
+        if (!cz.czytajTekst(nazwa) || wpiszPrzystanek(przystanki, nazwa) != i) {
+            return false;
+        }
+    }
+
+    if (!cz.czytaj(liczba) || !cz.miesci(liczba, sizeof(uint32_t) + sizeof(cena_grosze) + sizeof(minuty))) {
+        return false;
+    }
+    katalog_biletow &katalog = stan.bilety;
+    // nazwy wskazują do danych zrzutu; pusta nazwa jest zajęta przez pusty bilet
+    std::unordered_set<string_view> nazwy_biletow;
+    for (uint64_t i = 0; i < liczba; i++) {
+        string_view nazwa;
+        cena_grosze cena;
+        minuty czas;
+        if (!cz.czytajTekst(nazwa) || nazwa.empty() || !cz.czytaj(cena) || !cz.czytaj(czas) || cena == 0 ||
+            czas == std::numeric_limits<minuty>::max() || !nazwy_biletow.insert(nazwa).second) {
+            return false;
+        }
+        katalog.bilety.emplace_back(string{nazwa}, cena, czas);
+        dodajDoFrontu(katalog, katalog.bilety.size() - 1);
+    }
+    katalog.aktualne_warstwy = false;
+
+    if (!cz.czytaj(liczba) || !cz.miesci(liczba, sizeof(numer_kursu) + sizeof(uint32_t))) {
+        return false;
+    }
+    const minuta_dnia pierwsza = ileMinutOdPolnocy(poczatek_pracy), ostatnia = ileMinutOdPolnocy(koniec_pracy);
+    // numer ostatniego kursu, w którym wystąpił przystanek, żeby wykryć powtórzenie bez szukania w kursie
+    vector<uint64_t> kurs_przystanku(przystanki.nazwy.size(), liczba);
+    for (uint64_t i = 0; i < liczba; i++) {
+        numer_kursu numer;
+        uint32_t liczba_postojow;
+        if (!cz.czytaj(numer) || !cz.czytaj(liczba_postojow) ||
+            !cz.miesci(liczba_postojow, sizeof(id_przystanku) + sizeof(minuta_dnia))) {
+            return false;
+        }
+        kurs k(liczba_postojow);
+        for (size_t j = 0; j < k.size(); j++) {
+            postoj &postoj = k[j];
+            if (!cz.czytaj(postoj.first) || !cz.czytaj(postoj.second) || postoj.first >= przystanki.nazwy.size() ||
+                postoj.second < pierwsza || postoj.second > ostatnia || (j > 0 && k[j - 1].second >= postoj.second) ||
+                kurs_przystanku[postoj.first] == i) {
+                return false;
+            }
+            kurs_przystanku[postoj.first] = i;
+        }
+        if (!dodajKursDoRozkladu(stan.rozklad, numer, std::move(k))) {
+            return false;
+        }
+    }
+    return cz.koniec();
+}
+} // namespace Zrzut
+
+// Tryb serwera: rozkład i cennik zostają w pamięci, a klienci przez gniazdo uniksowe wysyłają
+// te same linie co na standardowe wejście. Każdy klient ma swój wątek. Zapytania czytają
+// opublikowaną wersję stanu, która się już nie zmienia, więc działają równolegle i nie czekają
+// na zmiany. Zmiany są wykonywane po kolei na kopii, która potem zastępuje opublikowaną wersję.
+namespace Serwer {
+struct wersja {
+    rozklad_kursow rozklad;
+    katalog_biletow bilety;
+};
+
+// Stan jest trzymany w dwóch kopiach (left-right). Zapytania czytają opublikowaną, a zmiany
+// trafiają najpierw do drugiej, która potem zostaje opublikowana; gdy dawną kopię opuszczą
+// ostatnie zapytania, te same linie są wykonywane i na niej. Zmiana kosztuje więc dwa
+// wykonania swoich linii i scalenie nowych połączeń z siatką, a nie kopię całego rozkładu,
+// za to stan zajmuje pamięć dwa razy. Zapis czeka tylko na zapytania już rozpoczęte.
+class Kasa {
+  public:
+    // Dopóki istnieje, kopia, którą czyta, nie jest zmieniana.
+    class Odczyt {
+      public:
+        Odczyt(const wersja &w, std::atomic<size_t> &czytelnicy) : w(&w), czytelnicy(&czytelnicy) {}
+        Odczyt(const Odczyt &) = delete;
+        Odczyt &operator=(const Odczyt &) = delete;
+        ~Odczyt() { czytelnicy->fetch_sub(1, std::memory_order_release); }
+
+        const wersja *operator->() const { return w; }
+
+      private:
+        const wersja *w;
+        std::atomic<size_t> *czytelnicy;
+    };
+
+    explicit Kasa(stan_kasy &stan) {
+        kopie[0].rozklad = std::move(stan.rozklad);
+        kopie[0].bilety = std::move(stan.bilety);
+        przygotuj(kopie[0]);
+        kopie[1] = kopie[0];
+    }
+
+    Odczyt odczyt() {
+        while (true) {
+            size_t i = opublikowana.load();
+            czytelnicy[i].fetch_add(1);
+            // zapis mógł opublikować drugą kopię, zanim zgłosiliśmy się do tej
+            if (opublikowana.load() == i) {
+                return Odczyt(kopie[i], czytelnicy[i]);
+            }
+            czytelnicy[i].fetch_sub(1);
+        }
+    }
+
+    // Wykonuje kolejne linie zmian; i-ty element wyniku mówi, czy i-ta linia była poprawna.
+    vector<bool> zmien(const vector<string_view> &linie) {
+        std::lock_guard<std::mutex> blokada(zmiany);
+        size_t stara = opublikowana.load(std::memory_order_relaxed), nowa = 1 - stara;
+        vector<bool> poprawne;
+        poprawne.reserve(linie.size());
+        for (string_view linia : linie) {
+            poprawne.push_back(zastosuj(kopie[nowa], linia, true));
+        }
+        przygotuj(kopie[nowa]);
+        opublikowana.store(nowa);
+        while (czytelnicy[stara].load() != 0) {
+            std::this_thread::yield();
+        }
+        for (string_view linia : linie) {
+            zastosuj(kopie[stara], linia, false);
+        }
+        przygotuj(kopie[stara]);
+        return poprawne;
+    }
+
+    // Po zakończeniu wszystkich sesji.
+    wersja zabierz() { return std::move(kopie[opublikowana.load()]); }
+
+  private:
+    static bool zastosuj(wersja &w, string_view linia, bool mierz) {
+        Pomiary::chwila poczatek = Pomiary::teraz();
+        Lekser::polecenie polecenie = Lekser::rozbierz(linia, pamiec_linii.zasob());
+        bool poprawne = std::visit(
+            overloaded{[&](const Lekser::dodanie_biletu &b) { return Interfejs::dodajBilet(w.bilety, b); },
+                       [&](const Lekser::dodanie_kursu &k) { return Interfejs::dodajKurs(w.rozklad, k); },
+                       [](const auto &) { return false; }},
+            polecenie);
+        if (mierz) {
+            Pomiary::polecenie(polecenie.index(), poczatek, poprawne);
+        }
+        polecenie = Lekser::pusta_linia{};
+        pamiec_linii.zwolnij();
+        return poprawne;
+    }
+
+    static void przygotuj(wersja &w) {
+        Interfejs::przygotujKatalog(w.bilety);
+        Interfejs::przygotujRozklad(w.rozklad);
+    }
+
+    std::mutex zmiany;
+    wersja kopie[2];
+    std::atomic<size_t> czytelnicy[2] = {};
+    std::atomic<size_t> opublikowana{0};
+};
+
+bool wyslij(int gniazdo, string_view dane) {
+    while (!dane.empty()) {
+        ssize_t wyslane = send(gniazdo, dane.data(), dane.size(), MSG_NOSIGNAL);
+        if (wyslane < 0 && errno == EINTR) {
+            continue;
+        }
+        if (wyslane <= 0) {
+            return false;
+        }
+        dane.remove_prefix(wyslane);
+    }
+    return true;
+}
+
+// Jedna sesja klienta: linie są numerowane od początku połączenia, błędy trafiają do tego
+// samego gniazda co odpowiedzi, a po zamknięciu wejścia przez klienta serwer odsyła liczbę
+// sprzedanych mu biletów, tak jak kasa na końcu standardowego wyjścia.
+class Sesja {
+  public:
+    Sesja(Kasa &kasa, int gniazdo) : kasa(kasa), gniazdo(gniazdo) {}
+
+    void obsluz() {
+        string wejscie;
+        char porcja[1 << 16];
+        while (true) {
+            ssize_t przeczytane = read(gniazdo, porcja, sizeof(porcja));
+            if (przeczytane < 0 && errno == EINTR) {
+                continue;
+            }
+            if (przeczytane <= 0) {
+                break;
+            }
+            wejscie.append(porcja, przeczytane);
+            size_t koniec = wejscie.rfind('\n');
+            if (koniec == string::npos) {
+                continue;
+            }
+            wykonaj(string_view(wejscie).substr(0, koniec + 1));
+            wejscie.erase(0, koniec + 1);
+            if (!wyslij(gniazdo, wyjscie.zabierz())) {
+                return;
+            }
+        }
+        // ostatnia linia nie musi kończyć się znakiem nowej linii
+        wykonaj(wejscie);
+        wyjscie << liczba_sprzedanych_biletow << "\n";
+        wyslij(gniazdo, wyjscie.zabierz());
+    }
+
+    const PamiecTras &pamiecTras() const { return trasy; }
+
+  private:
+    // Kolejne zmiany stanu są wykonywane razem na jednej kopii, a zapytanie po nich
+    // widzi już nową wersję, tak jak zmiany innych sesji opublikowane przed nim.
+    void wykonaj(string_view dane) {
+        vector<string_view> zmiany;
+        auto zastosujZmiany = [&] {
+            if (zmiany.empty()) {
+                return;
+            }
+            size_t pierwsza = numer_linii - zmiany.size() + 1;
+            vector<bool> poprawne = kasa.zmien(zmiany);
+            for (size_t i = 0; i < zmiany.size(); i++) {
+                if (!poprawne[i]) {
+                    blednaLinia(wyjscie, zmiany[i], pierwsza + i);
+                }
+            }
+            zmiany.clear();
+        };
+        Wejscie::dlaKazdejLinii(dane, [&](string_view linia) {
+            if (Lekser::zmieniaStan(linia)) {
+                numer_linii++;
+                zmiany.push_back(linia);
+                return;
+            }
+            zastosujZmiany();
+            numer_linii++;
+            odpowiedz(linia);
+        });
+        zastosujZmiany();
+    }
+
+    void odpowiedz(string_view linia) {
+        Kasa::Odczyt stan = kasa.odczyt();
+        Pomiary::chwila poczatek = Pomiary::teraz();
+        Lekser::polecenie polecenie = Lekser::rozbierz(linia, pamiec_linii.zasob());
+        auto wynik = Interfejs::odpowiedzNaLinie(stan->rozklad, stan->bilety, polecenie, &trasy);
+        bool poprawne = !wynik.has_value() || !std::holds_alternative<blad>(*wynik);
+        Pomiary::polecenie(polecenie.index(), poczatek, poprawne);
+        polecenie = Lekser::pusta_linia{};
+        pamiec_linii.zwolnij();
+        if (!poprawne) {
+            blednaLinia(wyjscie, linia, numer_linii);
+        } else if (wynik.has_value()) {
+            wypiszWynikZapytania(*wynik, stan->bilety, wyjscie, liczba_sprzedanych_biletow);
+        }
+    }
+
+    Kasa &kasa;
+    int gniazdo;
+    // wpisy pamięci tras są kluczowane pokoleniem rozkładu, więc przeżywają kolejne wersje
+    PamiecTras trasy;
+    BuforWyjscia wyjscie;
+    size_t numer_linii = 0, liczba_sprzedanych_biletow = 0;
+};
+
+int sygnal_konca[2] = {-1, -1}; // potok budzący pętlę przyjmującą połączenia
+
+void zakoncz(int) {
+    char c = 0;
+    [[maybe_unused]] ssize_t zapisane = write(sygnal_konca[1], &c, 1);
+}
+
+// Usuwa gniazdo zostawione pod ścieżką, ale nie zwykły plik ani nic innego, co tam leży.
+bool usunGniazdo(const char *sciezka) {
+    struct stat opis;
+    if (lstat(sciezka, &opis) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        cerr << "Cannot check " << sciezka << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    if (!S_ISSOCK(opis.st_mode)) {
+        cerr << "Not a socket, refusing to remove: " << sciezka << "\n";
+        return false;
+    }
+    if (unlink(sciezka) != 0 && errno != ENOENT) {
+        cerr << "Cannot remove " << sciezka << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Obsługuje klientów do SIGINT albo SIGTERM, a potem oddaje końcowy stan i łączne statystyki pamięci tras.
+bool uruchom(const char *sciezka, stan_kasy &stan) {
+    sockaddr_un adres{};
+    adres.sun_family = AF_UNIX;
+    if (std::strlen(sciezka) >= sizeof(adres.sun_path)) {
+        cerr << "Socket path too long: " << sciezka << "\n";
+        return false;
+    }
+    std::strcpy(adres.sun_path, sciezka);
+    if (!usunGniazdo(sciezka)) {
+        return false;
+    }
+    int nasluch = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (nasluch < 0) {
+        cerr << "Cannot listen on " << sciezka << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    if (bind(nasluch, reinterpret_cast<sockaddr *>(&adres), sizeof(adres)) != 0) {
+        cerr << "Cannot listen on " << sciezka << ": " << std::strerror(errno) << "\n";
+        close(nasluch);
+        return false;
+    }
+    if (listen(nasluch, SOMAXCONN) != 0 || pipe(sygnal_konca) != 0) {
+        cerr << "Cannot listen on " << sciezka << ": " << std::strerror(errno) << "\n";
+        close(nasluch);
+        usunGniazdo(sciezka);
+        return false;
+    }
+    struct sigaction akcja {};
+    akcja.sa_handler = zakoncz;
+    sigaction(SIGINT, &akcja, nullptr);
+    sigaction(SIGTERM, &akcja, nullptr);
+
+    Kasa kasa(stan);
+    std::mutex mutex;
+    std::condition_variable koniec_sesji;
+    std::unordered_set<int> klienci;
+    while (true) {
+        pollfd zdarzenia[] = {{nasluch, POLLIN, 0}, {sygnal_konca[0], POLLIN, 0}};
+        if (poll(zdarzenia, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (zdarzenia[1].revents != 0) {
+            break;
+        }
+        int klient = accept4(nasluch, nullptr, nullptr, SOCK_CLOEXEC);
+        if (klient < 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> blokada(mutex);
+        klienci.insert(klient);
+        std::thread([&, klient] {
+            Sesja sesja(kasa, klient);
+            sesja.obsluz();
+            std::lock_guard<std::mutex> blokada(mutex);
+            // każda sesja ma własną pamięć tras; statystyki pokazują je łącznie
+            stan.trasy.dolicz(sesja.pamiecTras());
+            close(klient);
+            klienci.erase(klient);
+            koniec_sesji.notify_all();
+        }).detach();
+    }
+    close(nasluch);
+    usunGniazdo(sciezka);
+    {
+        // przerywa czytanie u klientów, którzy jeszcze są połączeni
+        std::unique_lock<std::mutex> blokada(mutex);
+        for (int klient : klienci) {
+            shutdown(klient, SHUT_RDWR);
+        }
+        koniec_sesji.wait(blokada, [&] { return klienci.empty(); });
+    }
+    wersja koncowa = kasa.zabierz();
+    stan.rozklad = std::move(koncowa.rozklad);
+    stan.bilety = std::move(koncowa.bilety);
+    return true;
+}
+} // namespace Serwer
+
+// kasa_bench.cc dołącza ten plik z własnym main
+#ifndef KASA_BENCH
+namespace {
+// Liczba bez znaku zajmująca cały argument.
+bool wczytajLiczbe(string_view tekst, size_t &wynik) {
+    auto [koniec, kod] = std::from_chars(tekst.data(), tekst.data() + tekst.size(), wynik);
+    return kod == std::errc{} && koniec == tekst.data() + tekst.size();
+}
+
+// Każdy bilet jest ważny co najmniej minutę, więc więcej biletów niż minut najdłuższego
+// przejazdu nigdy się nie przyda; tyle też najwyżej warstw ma tabela planów.
+const size_t najwiecej_biletow = najdluzszy_przejazd + 1;
+} // namespace
+
+int main(int argc, char *argv[]) {
+    bool statystyki = false, statystyki_json = false;
+    const char *plik = nullptr;
+    size_t liczba_watkow = 0;
+    bool potok = false;
+    const char *wczytywany_zrzut = nullptr;
+    const char *zapisywany_zrzut = nullptr;
+    size_t maks_biletow = domyslnie_biletow;
+    const char *gniazdo = nullptr;
+    vector<const char *> pliki_rozkladu;
+    for (int i = 1; i < argc; i++) {
+        if (string_view{argv[i]} == "--stats") {
+            statystyki = true;
+        } else if (string_view{argv[i]} == "--stats-json") {
+            statystyki_json = true;
+        } else if (string_view{argv[i]} == "--snapshot" && i + 1 < argc) {
+            wczytywany_zrzut = argv[++i];
+        } else if (string_view{argv[i]} == "--dump-snapshot" && i + 1 < argc) {
+            zapisywany_zrzut = argv[++i];
+        } else if (string_view{argv[i]} == "--timetable" && i + 1 < argc) {
+            pliki_rozkladu.push_back(argv[++i]);
+        } else if (string_view{argv[i]} == "--listen" && i + 1 < argc) {
+            gniazdo = argv[++i];
+        } else if (string_view{argv[i]} == "--pipeline") {
+            potok = true;
+        } else if (string_view{argv[i]} == "--max-tickets" && i + 1 < argc) {
+            if (!wczytajLiczbe(argv[++i], maks_biletow) || maks_biletow == 0 || maks_biletow > najwiecej_biletow) {
+                cerr << "--max-tickets expects a number from 1 to " << najwiecej_biletow << "\n";
+                return 1;
+            }
+        } else if (string_view{argv[i]} == "--threads" && i + 1 < argc) {
+            if (!wczytajLiczbe(argv[++i], liczba_watkow)) {
+                cerr << "--threads expects a number\n";
+                return 1;
+            }
+        } else if (argv[i][0] != '-' && plik == nullptr) {
+            plik = argv[i];
+        } else {
+            cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    if (gniazdo != nullptr && (potok || liczba_watkow > 0 || plik != nullptr)) {
+        cerr << "--listen cannot be combined with --pipeline, --threads or an input file\n";
+        return 1;
+    }
+    if (potok && liczba_watkow > 0) {
+        cerr << "--pipeline cannot be combined with --threads\n";
+        return 1;
+    }
+
+    std::optional<Wejscie::MapowanyPlik> mapowanie;
+    if (plik != nullptr) {
+        mapowanie.emplace(plik);
+        if (!mapowanie->otwarty()) {
+            cerr << "Cannot read " << plik << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+    }
+    auto czytaj = [&](auto f) {
+        if (mapowanie) {
+            Wejscie::dlaKazdejLinii(mapowanie->zawartosc(), f);
+        } else {
+            Wejscie::dlaKazdejLinii(std::cin, f);
+        }
+    };
+
+    Pomiary::wlaczone = statystyki || statystyki_json;
+
+    stan_kasy stan;
+    stan.bilety.maks_biletow = maks_biletow;
+    if (wczytywany_zrzut != nullptr) {
+        Wejscie::MapowanyPlik zrzut(wczytywany_zrzut);
+        if (!zrzut.otwarty()) {
+            cerr << "Cannot read " << wczytywany_zrzut << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        if (!Zrzut::wczytaj(stan, zrzut.zawartosc())) {
+            cerr << "Invalid snapshot: " << wczytywany_zrzut << "\n";
+            return 1;
+        }
+    }
+    if (!pliki_rozkladu.empty() && !Scalanie::wczytajPliki(stan.rozklad, pliki_rozkladu)) {
+        return 1;
+    }
+
+    BuforWyjscia wyjscie(&cout);
+    if (gniazdo != nullptr) {
+        if (!Serwer::uruchom(gniazdo, stan)) {
+            return 1;
+        }
+    } else if (potok) {
+        Potok::uruchom(stan, czytaj);
+    } else {
+        wykonajWejscie(stan, liczba_watkow, wyjscie, czytaj);
+    }
+    // w trybie serwera liczbę sprzedanych biletów dostaje każdy klient
+    if (gniazdo == nullptr) {
+        wyjscie << stan.liczba_sprzedanych_biletow << "\n";
+    }
+    wyjscie.oproznij();
+    cout.flush();
+    if (statystyki) {
+        wypiszStatystykiBiletow(stan.bilety);
+        wypiszStatystykiTras(stan.trasy);
+        Pomiary::wypisz(cerr);
+    }
+    if (statystyki_json) {
+        Pomiary::wypiszJson(cerr);
+    }
+    if (zapisywany_zrzut != nullptr && !Zrzut::zapisz(stan, zapisywany_zrzut)) {
+        cerr << "Cannot write snapshot: " << zapisywany_zrzut << "\n";
+        return 1;
     }
-    std::cout << liczba_sprzedanych_biletow << std::endl;
 }
+#endif
@@ -0,0 +1,229 @@
+// Benchmark głównych funkcji kasy na danych z generatora (generator.cc).
+//
+//   g++ -std=c++17 -O2 -pthread kasa_bench.cc -o kasa_bench
+//   ./generator --courses 50000 --queries 500000 > dane.txt && ./kasa_bench dane.txt
+//
+// Dla każdej funkcji wypisuje przepustowość, percentyle czasu pojedynczego wywołania
+// i średnią liczbę przydziałów pamięci ze sterty na wywołanie.
+// Funkcje, które nie zmieniają stanu, są najpierw wywoływane bez mierzenia pojedynczych
+// wywołań, żeby odczyt zegara nie zaniżał przepustowości. Na końcu mierzy przepustowość
+// całego wejścia w każdym układzie etapów: po kolei, z --threads i z --pipeline.
+#define KASA_BENCH
+#pragma GCC diagnostic push
+// bez main z kasa.cc część funkcji nie jest używana
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#include "kasa.cc"
+#pragma GCC diagnostic pop
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> przydzialy{0};
+}
+
+// Zliczanie przydziałów: operator new[] i wersje bez wyjątków korzystają z tych operatorów;
+// std::pmr::new_delete_resource() używa wersji z wyrównaniem.
+#pragma GCC diagnostic push
+// po wstawieniu operatora delete kompilator widzi free na wyniku operatora new, nie malloc
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(std::size_t rozmiar) {
+    przydzialy.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(rozmiar == 0 ? 1 : rozmiar)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new(std::size_t rozmiar, std::align_val_t wyrownanie) {
+    przydzialy.fetch_add(1, std::memory_order_relaxed);
+    size_t w = static_cast<size_t>(wyrownanie);
+    if (void *p = std::aligned_alloc(w, (rozmiar + w - 1) / w * w)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+namespace {
+namespace Benchmark {
+using zegar = std::chrono::steady_clock;
+
+uint64_t nanosekund(zegar::duration d) { return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(); }
+
+void wypisz(const char *nazwa, vector<uint64_t> &czasy, uint64_t lacznie_ns, uint64_t liczba_przydzialow) {
+    if (czasy.empty()) {
+        cout << std::left << std::setw(34) << nazwa << "no calls\n";
+        return;
+    }
+    std::sort(begin(czasy), end(czasy));
+    auto percentyl = [&](double p) { return czasy[std::min(czasy.size() - 1, size_t(p * czasy.size() / 100))]; };
+    double na_sekunde = lacznie_ns == 0 ? 0 : 1e9 * czasy.size() / lacznie_ns;
+    cout << std::left << std::setw(34) << nazwa << std::right << std::setw(10) << czasy.size() << " calls"
+         << std::setw(14) << std::fixed << std::setprecision(0) << na_sekunde << " /s"
+         << "   p50 " << std::setw(7) << percentyl(50) << " ns   p90 " << std::setw(7) << percentyl(90)
+         << " ns   p99 " << std::setw(8) << percentyl(99) << " ns   max " << std::setw(9) << czasy.back()
+         << " ns   allocs " << std::setprecision(2) << double(liczba_przydzialow) / czasy.size() << "\n";
+}
+
+// Nie pozwala kompilatorowi usunąć obliczenia, którego wynik nie jest używany.
+template <typename T> void zachowaj(const T &wynik) { asm volatile("" : : "r"(&wynik) : "memory"); }
+
+// Mierzy f(i) dla każdego i z [0, n); przydziały liczy w przebiegu z pomiarem wywołań,
+// czyli przy funkcjach tylko czytających już po rozgrzaniu.
+template <typename F> void zmierz(const char *nazwa, size_t n, bool tylko_czyta, F f) {
+    uint64_t lacznie = 0;
+    if (tylko_czyta) {
+        auto poczatek = zegar::now();
+        for (size_t i = 0; i < n; i++) {
+            f(i);
+        }
+        lacznie = nanosekund(zegar::now() - poczatek);
+    }
+    vector<uint64_t> czasy;
+    czasy.reserve(n);
+    uint64_t przydzialy_przed = przydzialy.load(std::memory_order_relaxed);
+    auto poczatek = zegar::now();
+    for (size_t i = 0; i < n; i++) {
+        auto przed = zegar::now();
+        f(i);
+        czasy.push_back(nanosekund(zegar::now() - przed));
+    }
+    if (!tylko_czyta) {
+        lacznie = nanosekund(zegar::now() - poczatek);
+    }
+    wypisz(nazwa, czasy, lacznie, przydzialy.load(std::memory_order_relaxed) - przydzialy_przed);
+}
+
+// Czas całego przebiegu od pustego stanu; cout i cerr na ten czas niczego nie wypisują.
+template <typename F> void zmierzCalosc(const char *nazwa, size_t liczba_linii, F f) {
+    std::streambuf *wyjscie = cout.rdbuf(nullptr), *bledy = cerr.rdbuf(nullptr);
+    stan_kasy stan;
+    auto poczatek = zegar::now();
+    f(stan);
+    uint64_t lacznie = nanosekund(zegar::now() - poczatek);
+    cout.rdbuf(wyjscie);
+    cerr.rdbuf(bledy);
+    cout.clear();
+    cerr.clear();
+    cout << std::left << std::setw(34) << nazwa << std::right << std::setw(14) << std::fixed << std::setprecision(0)
+         << (lacznie == 0 ? 0 : 1e9 * liczba_linii / lacznie) << " lines/s" << std::setw(10) << std::setprecision(3)
+         << lacznie / 1e9 << " s\n";
+}
+
+template <typename T> vector<const T *> wybierz(const vector<Lekser::polecenie> &polecenia) {
+    vector<const T *> wynik;
+    for (const auto &p : polecenia) {
+        if (const T *t = std::get_if<T>(&p)) {
+            wynik.push_back(t);
+        }
+    }
+    return wynik;
+}
+
+void uruchom(string_view dane) {
+    vector<string_view> linie;
+    Wejscie::dlaKazdejLinii(dane, [&](string_view linia) { linie.push_back(linia); });
+    vector<Lekser::polecenie> polecenia(linie.size());
+
+    zmierz("Lekser::rozbierz", linie.size(), true, [&](size_t i) { polecenia[i] = Lekser::rozbierz(linie[i]); });
+
+    auto bilety = wybierz<Lekser::dodanie_biletu>(polecenia);
+    auto kursy = wybierz<Lekser::dodanie_kursu>(polecenia);
+    auto zapytania = wybierz<Lekser::zapytanie>(polecenia);
+    auto podroze = wybierz<Lekser::zapytanie_o_podroz>(polecenia);
+    auto odjazdy = wybierz<Lekser::zapytanie_o_odjazdy>(polecenia);
+    cout << "lines: " << linie.size() << ", tickets: " << bilety.size() << ", courses: " << kursy.size()
+         << ", ticket queries: " << zapytania.size() << ", journeys: " << podroze.size()
+         << ", departure boards: " << odjazdy.size() << "\n";
+
+    stan_kasy stan;
+    zmierz("Interfejs::dodajBilet", bilety.size(), false,
+           [&](size_t i) { Interfejs::dodajBilet(stan.bilety, *bilety[i]); });
+    zmierz("przeliczWarstwy", 20, true, [&](size_t) { przeliczWarstwy(stan.bilety); });
+    zmierz("Interfejs::dodajKurs", kursy.size(), false,
+           [&](size_t i) { Interfejs::dodajKurs(stan.rozklad, *kursy[i]); });
+    Interfejs::przygotujRozklad(stan.rozklad);
+
+    // nazwy przystanków są zamieniane na identyfikatory przed pomiarem
+    vector<std::pmr::vector<id_przystanku>> przystanki(zapytania.size());
+    for (size_t i = 0; i < zapytania.size(); i++) {
+        for (string_view p : zapytania[i]->przystanki) {
+            przystanki[i].push_back(znajdzPrzystanek(stan.rozklad.przystanki, p));
+        }
+    }
+    zmierz("zapytaj", zapytania.size(), true, [&](size_t i) {
+        zachowaj(zapytaj(stan.rozklad, stan.bilety, przystanki[i], zapytania[i]->numeryKursow));
+    });
+    zmierz("zapytaj (with route cache)", zapytania.size(), false, [&](size_t i) {
+        zachowaj(zapytaj(stan.rozklad, stan.bilety, przystanki[i], zapytania[i]->numeryKursow, &stan.trasy));
+    });
+    const size_t czasow = 1 << 20;
+    zmierz("znajdzNajtanszyZestawBiletow", czasow, true,
+           [&](size_t i) { zachowaj(znajdzNajtanszyZestawBiletow(stan.bilety, i * 7919 % (najdluzszy_przejazd + 1))); });
+    zmierz("Interfejs::odpowiedz (journey)", podroze.size(), true,
+           [&](size_t i) { zachowaj(Interfejs::odpowiedz(stan.rozklad, stan.bilety, *podroze[i])); });
+    zmierz("Interfejs::odpowiedz (departures)", odjazdy.size(), true,
+           [&](size_t i) { zachowaj(Interfejs::odpowiedz(stan.rozklad, *odjazdy[i])); });
+
+    // całe wejście tak jak w main, z wypisywaniem do pustego strumienia
+    std::ostream nigdzie(nullptr);
+    BuforWyjscia wyjscie(&nigdzie);
+    stan_kasy od_zera;
+    zmierz("all lines (wykonajLinie)", linie.size(), false,
+           [&](size_t i) { Interfejs::wykonajLinie(od_zera, linie[i], wyjscie); });
+    // zapytania o bilety na ustalonym już stanie: nie powinny przydzielać pamięci
+    vector<string_view> linie_zapytan;
+    for (size_t i = 0; i < linie.size(); i++) {
+        if (std::holds_alternative<Lekser::zapytanie>(polecenia[i])) {
+            linie_zapytan.push_back(linie[i]);
+        }
+    }
+    zmierz("ticket query lines (wykonajLinie)", linie_zapytan.size(), true,
+           [&](size_t i) { Interfejs::wykonajLinie(od_zera, linie_zapytan[i], wyjscie); });
+
+    // to samo co main w każdym trybie, łącznie z liczbą sprzedanych biletów na końcu
+    auto czytaj = [&](auto f) { Wejscie::dlaKazdejLinii(dane, f); };
+    auto wykonajWszystko = [&](size_t liczba_watkow) {
+        return [&, liczba_watkow](stan_kasy &stan) {
+            BuforWyjscia wyjscie(&cout);
+            wykonajWejscie(stan, liczba_watkow, wyjscie, czytaj);
+            wyjscie << stan.liczba_sprzedanych_biletow << "\n";
+        };
+    };
+    zmierzCalosc("end-to-end: sequential", linie.size(), wykonajWszystko(0));
+    size_t rdzenie = std::max(2u, std::thread::hardware_concurrency());
+    for (size_t watki = 2; watki <= rdzenie; watki *= 2) {
+        string nazwa = "end-to-end: --threads " + std::to_string(watki);
+        zmierzCalosc(nazwa.c_str(), linie.size(), wykonajWszystko(watki));
+    }
+    zmierzCalosc("end-to-end: --pipeline", linie.size(), [&](stan_kasy &stan) {
+        Potok::uruchom(stan, czytaj);
+        cout << stan.liczba_sprzedanych_biletow << "\n";
+    });
+}
+} // namespace Benchmark
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        cerr << "Usage: " << argv[0] << " [FILE]\n";
+        return 1;
+    }
+    if (argc == 2) {
+        Wejscie::MapowanyPlik plik(argv[1]);
+        if (!plik.otwarty()) {
+            cerr << "Cannot read " << argv[1] << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        Benchmark::uruchom(plik.zawartosc());
+    } else {
+        string dane{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+        Benchmark::uruchom(dane);
+    }
+}
@@ -0,0 +1,139 @@
+// Porównanie rozbioru linii: dawne wzorce std::regex z ponownym czytaniem przez istringstream
+// i lekser z kasa.cc, na tym samym wejściu.
+//
+//   g++ -std=c++17 -O2 -pthread rozbior_bench.cc -o rozbior_bench
+//   ./generator --courses 50000 --queries 500000 --mix 100:0:0 > dane.txt && ./rozbior_bench dane.txt
+//
+// Dawna kasa nie znała zapytań o podróż (>) ani o odjazdy (@), więc takie linie odrzuca;
+// wejście najlepiej generować z samymi zapytaniami o bilety. Oba przebiegi tylko rozbierają
+// linie, bez wykonywania poleceń.
+#define KASA_BENCH
+#pragma GCC diagnostic push
+// bez main z kasa.cc część funkcji nie jest używana
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#include "kasa.cc"
+#pragma GCC diagnostic pop
+
+#include <iomanip>
+#include <regex>
+#include <sstream>
+
+namespace {
+// Wzorce i odczyt pól tak jak w kasie sprzed leksera.
+namespace Regex {
+using std::istringstream;
+using std::regex;
+const regex nazwa_biletu("([a-zA-Z ]+) ");
+const regex zapytanie_o_bilety("^\\?"                    // znak zapytania
+                               "( [a-zA-Z_\\^]+ \\d+)+ " // para: (przystanek, numer kursu)
+                               "([a-zA-Z_\\^]+)$");      // ostatni przystanek
+const regex dodaj_bilet("^([a-zA-Z ]+)"                  // nazwa biletu
+                        " "
+                        "(\\d+\\.\\d{2})" // cena
+                        " "
+                        "([1-9]\\d*)$"); // czas w minutach
+const regex dodaj_kurs("^(\\d+)"         // numer kursu
+                       "( [1-9]\\d?:\\d{2} [a-zA-Z_\\^]+)+$");
+
+std::istream &operator>>(std::istream &in, punkt_w_czasie &p) {
+    char c;
+    in >> p.first >> c >> p.second;
+    return in;
+}
+
+// Zwraca liczbę odczytanych pól albo 0 dla linii odrzuconej.
+size_t rozbierz(const string &linia) {
+    if (regex_match(linia, dodaj_bilet)) {
+        std::smatch result;
+        regex_search(linia, result, nazwa_biletu);
+        string nazwa = result.str(1);
+        istringstream ss(result.suffix());
+        uint64_t zlote, grosze;
+        minuty czas;
+        ss >> zlote;
+        ss.ignore(1); // kropka dziesiętna
+        ss >> grosze >> czas;
+        return 4;
+    }
+    if (regex_match(linia, zapytanie_o_bilety)) {
+        istringstream ss(linia);
+        ss.ignore(1); // znak zapytania
+        vector<przystanek> przystanki;
+        vector<numer_kursu> numeryKursow;
+        przystanek p;
+        numer_kursu n;
+        ss >> p;
+        przystanki.emplace_back(p);
+        while (ss >> n >> p) {
+            numeryKursow.emplace_back(n);
+            przystanki.emplace_back(p);
+        }
+        return przystanki.size() + numeryKursow.size();
+    }
+    if (regex_match(linia, dodaj_kurs)) {
+        istringstream ss(linia);
+        numer_kursu numerKursu;
+        ss >> numerKursu;
+        vector<pair<punkt_w_czasie, przystanek>> postoje;
+        punkt_w_czasie czas;
+        przystanek przyst;
+        while (ss >> czas >> przyst) {
+            postoje.emplace_back(czas, przyst);
+        }
+        return 1 + 2 * postoje.size();
+    }
+    return linia.empty() ? 1 : 0;
+}
+} // namespace Regex
+
+size_t polaPolecenia(const Lekser::polecenie &polecenie) {
+    return std::visit(overloaded{[](const Lekser::pusta_linia &) -> size_t { return 1; },
+                                 [](const Lekser::dodanie_biletu &) -> size_t { return 4; },
+                                 [](const Lekser::zapytanie &z) { return z.przystanki.size() + z.numeryKursow.size(); },
+                                 [](const Lekser::dodanie_kursu &k) { return 1 + 2 * k.postoje.size(); },
+                                 [](const Lekser::zapytanie_o_podroz &) -> size_t { return 3; },
+                                 [](const Lekser::zapytanie_o_odjazdy &) -> size_t { return 3; },
+                                 [](const blad &) -> size_t { return 0; }},
+                      polecenie);
+}
+
+template <typename F> void zmierz(const char *nazwa, const vector<string> &linie, F rozbierz) {
+    auto poczatek = std::chrono::steady_clock::now();
+    size_t pola = 0, odrzucone = 0;
+    for (const string &linia : linie) {
+        size_t n = rozbierz(linia);
+        pola += n;
+        odrzucone += n == 0;
+    }
+    double sekundy = std::chrono::duration<double>(std::chrono::steady_clock::now() - poczatek).count();
+    cout << std::left << std::setw(8) << nazwa << std::right << std::fixed << std::setprecision(0) << std::setw(12)
+         << linie.size() / sekundy << " lines/s" << std::setprecision(3) << std::setw(10) << sekundy
+         << " s   fields " << pola << ", rejected " << odrzucone << "\n";
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        cerr << "Usage: " << argv[0] << " [FILE]\n";
+        return 1;
+    }
+    vector<string> linie;
+    auto dodaj = [&](string_view linia) { linie.emplace_back(linia); };
+    if (argc == 2) {
+        Wejscie::MapowanyPlik plik(argv[1]);
+        if (!plik.otwarty()) {
+            cerr << "Cannot read " << argv[1] << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        Wejscie::dlaKazdejLinii(plik.zawartosc(), dodaj);
+    } else {
+        Wejscie::dlaKazdejLinii(std::cin, dodaj);
+    }
+    zmierz("regex", linie, Regex::rozbierz);
+    zmierz("lexer", linie, [](const string &linia) {
+        size_t pola = polaPolecenia(Lekser::rozbierz(linia, pamiec_linii.zasob()));
+        pamiec_linii.zwolnij();
+        return pola;
+    });
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Uruchamia kasę na każdym pliku testy/*.in we wszystkich trybach wykonania i porównuje
+# standardowe wyjście z plikiem .out, a standardowe wyjście błędów z plikiem .err.
+#
+#   g++ -std=c++17 -O2 -pthread kasa.cc -o kasa && testy/sprawdz.sh ./kasa
+kasa=${1:?"Usage: $0 KASA"}
+katalog=$(dirname "$0")
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+bledy=0
+for wejscie in "$katalog"/*.in; do
+    test=${wejscie%.in}
+    for tryb in "" "--threads 4" "--pipeline"; do
+        # shellcheck disable=SC2086
+        "$kasa" $tryb < "$wejscie" > "$tmp/out" 2> "$tmp/err"
+        if cmp -s "$tmp/out" "$test.out" && cmp -s "$tmp/err" "$test.err"; then
+            echo "ok   $(basename "$test") $tryb"
+        else
+            echo "FAIL $(basename "$test") $tryb"
+            diff "$test.out" "$tmp/out"
+            diff "$test.err" "$tmp/err"
+            bledy=$((bledy + 1))
+        fi
+    done
+done
+exit $((bledy > 0))
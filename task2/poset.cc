@@ -1,8 +1,14 @@
 #include <cassert>
+#include <cstdint>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <unordered_map>
-#include <unordered_set>
+#include <variant>
+#include <vector>
 
 #include "poset.h"
 
@@ -28,13 +34,66 @@
 #define RETURNS(val) INFO("returns ", (val))
 
 namespace {
-enum PosetElem { NORMAL, REVERSED, NAMES, NEXT_FREE_SPOT };
+enum PosetElem {
+    CLOSURE,
+    NAMES,
+    NEXT_FREE_SPOT,
+    FREE_SPOTS,
+    RELATION_COUNT,
+    SLOTS
+};
+enum Direction { NORMAL, REVERSED };
 
 using ID = unsigned long;
 using NameToId = std::unordered_map<std::string, ID>;
-using NeighbourSet = std::unordered_set<ID>;
-using AdjacencyLists = std::unordered_map<ID, NeighbourSet>;
-using Poset = std::tuple<AdjacencyLists, AdjacencyLists, NameToId, size_t>;
+using Word = uint64_t;
+const size_t WORD_BITS = 64;
+
+// Sparse rows: sorted ids of the related elements, one list per element id.
+using SortedLists = std::vector<std::vector<ID>>;
+
+// Dense rows: row-major bit matrix with one row per element id. Rows are plain
+// word arrays, so the row operations below are simple loops the compiler can
+// vectorise.
+struct BitMatrix {
+    size_t stride = 0; // words per row
+    std::vector<Word> words;
+};
+
+// The whole transitive closure is stored in both directions: a NORMAL row
+// holds every element below the given one and a REVERSED row every element
+// above it. Small or sparse posets keep sorted lists, the others bit matrices;
+// adapt_storage switches between the two after every change.
+template <typename Rows> using Closure = std::array<Rows, 2>;
+using Storage = std::variant<Closure<SortedLists>, Closure<BitMatrix>>;
+
+// Name (null for a free id) and generation of an element id. The generation
+// changes whenever the id is freed, which makes handles to it stale.
+struct Slot {
+    std::string const *name = nullptr;
+    uint32_t generation = 1;
+};
+
+// Ids of removed elements are reused, so that the rows stay dense.
+// RELATION_COUNT is the number of pairs a < b with a != b; with bit matrices
+// it is only a lower bound, because counting the bits set by each row OR would
+// cost as much as the OR itself, and count_relations makes it exact.
+using Poset = std::tuple<Storage, NameToId, size_t, std::vector<ID>, size_t,
+                         std::vector<Slot>>;
+
+// A handle is an element id in the low bits and the generation of its slot in
+// the high ones. Generations start at 1, so 0 is never a valid handle.
+using Handle = unsigned long long;
+const unsigned SLOT_BITS = 32;
+
+// A poset with at least min_dense_size elements becomes dense once
+// dense_density of all pairs are related and sparse again below
+// sparse_density; the gap keeps it from switching back and forth.
+struct Thresholds {
+    size_t min_dense_size = 64;
+    double dense_density = 1.0 / 256;
+    double sparse_density = 1.0 / 1024;
+};
 
 #ifdef NDEBUG
 const bool debug = false;
@@ -49,6 +108,11 @@ std::unordered_map<ID, Poset> &posets() {
     return posets_;
 }
 
+Thresholds &thresholds() {
+    static Thresholds thresholds_ = {};
+    return thresholds_;
+}
+
 template <typename T> void logDebug(T t) { std::cerr << t << std::endl; }
 
 template <typename T, typename... Args> void logDebug(T t, Args... args) {
@@ -57,11 +121,226 @@ template <typename T, typename... Args> void logDebug(T t, Args... args) {
     logDebug(args...);
 }
 
-template <typename T, typename T_elem>
-void assert_contains(T const &container, T_elem const &elem) {
-    if (debug) {
-        if (container.find(elem) == container.end()) {
-            ERROR("container doesn't hold element");
+Word *row(BitMatrix &matrix, ID id) {
+    return matrix.words.data() + id * matrix.stride;
+}
+
+Word const *row(BitMatrix const &matrix, ID id) {
+    return matrix.words.data() + id * matrix.stride;
+}
+
+bool test(BitMatrix const &matrix, ID row_id, ID id) {
+    return (row(matrix, row_id)[id / WORD_BITS] >> (id % WORD_BITS)) & 1;
+}
+
+bool test(SortedLists const &lists, ID row_id, ID id) {
+    return std::binary_search(lists[row_id].begin(), lists[row_id].end(), id);
+}
+
+// Both return whether the relation is new.
+bool set(BitMatrix &matrix, ID row_id, ID id) {
+    Word &word = row(matrix, row_id)[id / WORD_BITS];
+    Word bit = Word{1} << (id % WORD_BITS);
+    bool added = (word & bit) == 0;
+    word |= bit;
+    return added;
+}
+
+bool set(SortedLists &lists, ID row_id, ID id) {
+    std::vector<ID> &list = lists[row_id];
+    auto it = std::lower_bound(list.begin(), list.end(), id);
+    if (it != list.end() && *it == id) {
+        return false;
+    }
+    list.insert(it, id);
+    return true;
+}
+
+void clear(BitMatrix &matrix, ID row_id, ID id) {
+    row(matrix, row_id)[id / WORD_BITS] &= ~(Word{1} << (id % WORD_BITS));
+}
+
+void clear(SortedLists &lists, ID row_id, ID id) {
+    std::vector<ID> &list = lists[row_id];
+    auto it = std::lower_bound(list.begin(), list.end(), id);
+    if (it != list.end() && *it == id) {
+        list.erase(it);
+    }
+}
+
+template <typename F> void for_each(BitMatrix const &matrix, ID row_id, F f) {
+    Word const *words = row(matrix, row_id);
+    for (size_t i = 0; i < matrix.stride; ++i) {
+        for (Word bits = words[i]; bits != 0; bits &= bits - 1) {
+            f(i * WORD_BITS + __builtin_ctzll(bits));
+        }
+    }
+}
+
+template <typename F> void for_each(SortedLists const &lists, ID row_id, F f) {
+    for (ID id : lists[row_id]) {
+        f(id);
+    }
+}
+
+// Adds the source row to the target row (a word-wide OR for bit matrices) and
+// returns the number of new relations, or 0 if it is not known.
+size_t merge_rows(BitMatrix &matrix, ID target_id, ID source_id) {
+    Word *target = row(matrix, target_id);
+    Word const *source = row(matrix, source_id);
+    // a local copy, since stores to the row could alias the stride
+    size_t const stride = matrix.stride;
+    for (size_t i = 0; i < stride; ++i) {
+        target[i] |= source[i];
+    }
+    return 0;
+}
+
+size_t merge_rows(SortedLists &lists, ID target_id, ID source_id) {
+    std::vector<ID> &target = lists[target_id];
+    std::vector<ID> const &source = lists[source_id];
+    std::vector<ID> merged;
+    merged.reserve(target.size() + source.size());
+    std::set_union(target.begin(), target.end(), source.begin(), source.end(),
+                   std::back_inserter(merged));
+    size_t added = merged.size() - target.size();
+    target = std::move(merged);
+    return added;
+}
+
+bool rows_intersect(BitMatrix const &matrix1, ID row1_id,
+                    BitMatrix const &matrix2, ID row2_id) {
+    Word const *row1 = row(matrix1, row1_id);
+    Word const *row2 = row(matrix2, row2_id);
+    Word common = 0;
+    for (size_t i = 0; i < matrix1.stride; ++i) {
+        common |= row1[i] & row2[i];
+    }
+    return common != 0;
+}
+
+bool rows_intersect(SortedLists const &lists1, ID row1_id,
+                    SortedLists const &lists2, ID row2_id) {
+    auto it1 = lists1[row1_id].begin(), end1 = lists1[row1_id].end();
+    auto it2 = lists2[row2_id].begin(), end2 = lists2[row2_id].end();
+    while (it1 != end1 && it2 != end2) {
+        if (*it1 == *it2) {
+            return true;
+        }
+        if (*it1 < *it2) {
+            ++it1;
+        } else {
+            ++it2;
+        }
+    }
+    return false;
+}
+
+size_t row_size(BitMatrix const &matrix, ID row_id) {
+    Word const *words = row(matrix, row_id);
+    size_t size = 0;
+    for (size_t i = 0; i < matrix.stride; ++i) {
+        size += __builtin_popcountll(words[i]);
+    }
+    return size;
+}
+
+size_t row_size(SortedLists const &lists, ID row_id) {
+    return lists[row_id].size();
+}
+
+// Makes room for the row and the column of the given id. Rows are widened by
+// doubling, so that inserting n elements copies O(n^2) bits in total.
+void reserve_id(BitMatrix &matrix, ID id) {
+    size_t rows = matrix.stride == 0 ? 0 : matrix.words.size() / matrix.stride;
+    if (id / WORD_BITS >= matrix.stride) {
+        size_t stride = std::max<size_t>(1, matrix.stride);
+        while (id / WORD_BITS >= stride) {
+            stride *= 2;
+        }
+        std::vector<Word> wider(rows * stride);
+        for (size_t r = 0; r < rows; ++r) {
+            std::copy(row(matrix, r), row(matrix, r) + matrix.stride,
+                      wider.data() + r * stride);
+        }
+        matrix.words = std::move(wider);
+        matrix.stride = stride;
+    }
+    if (id >= rows) {
+        matrix.words.resize((id + 1) * matrix.stride);
+    }
+}
+
+void reserve_id(SortedLists &lists, ID id) {
+    if (id >= lists.size()) {
+        lists.resize(id + 1);
+    }
+}
+
+void clear_row(BitMatrix &matrix, ID id) {
+    std::fill(row(matrix, id), row(matrix, id) + matrix.stride, Word{0});
+}
+
+void clear_row(SortedLists &lists, ID id) {
+    lists[id].clear();
+    lists[id].shrink_to_fit();
+}
+
+// Rebuilds the closure in the other representation; ids stay the same.
+template <typename Target, typename Source>
+Closure<Target> convert(Closure<Source> const &closure, size_t ids) {
+    Closure<Target> converted;
+    for (Direction direction : {NORMAL, REVERSED}) {
+        if (ids > 0) {
+            reserve_id(converted[direction], ids - 1);
+        }
+        for (ID row_id = 0; row_id < ids; ++row_id) {
+            for_each(closure[direction], row_id, [&](ID id) {
+                set(converted[direction], row_id, id);
+            });
+        }
+    }
+    return converted;
+}
+
+size_t count_relations(Poset &poset) {
+    size_t &relations = std::get<RELATION_COUNT>(poset);
+    relations = 0;
+    std::visit(
+        [&](auto const &closure) {
+            for (ID id = 0; id < std::get<NEXT_FREE_SPOT>(poset); ++id) {
+                relations += row_size(closure[NORMAL], id);
+            }
+        },
+        std::get<CLOSURE>(poset));
+    return relations;
+}
+
+void forget_relations(Poset &poset, size_t removed) {
+    size_t &relations = std::get<RELATION_COUNT>(poset);
+    relations -= std::min(relations, removed);
+}
+
+void adapt_storage(Poset &poset) {
+    Thresholds const &t = thresholds();
+    double elements = std::get<NAMES>(poset).size();
+    bool big = elements >= t.min_dense_size;
+    size_t ids = std::get<NEXT_FREE_SPOT>(poset);
+    Storage &storage = std::get<CLOSURE>(poset);
+    if (auto *sparse = std::get_if<Closure<SortedLists>>(&storage)) {
+        double relations = std::get<RELATION_COUNT>(poset);
+        if (big && relations >= t.dense_density * elements * elements) {
+            INFO("switching to bit matrices, elements=", elements);
+            storage = convert<BitMatrix>(*sparse, ids);
+        }
+    } else if (auto *dense = std::get_if<Closure<BitMatrix>>(&storage)) {
+        double sparse_limit = t.sparse_density * elements * elements;
+        // the lower bound is recounted only when it falls under the limit
+        if (!big || (std::get<RELATION_COUNT>(poset) < sparse_limit &&
+                     count_relations(poset) < sparse_limit)) {
+            INFO("switching to sorted lists, elements=", elements);
+            storage = convert<SortedLists>(*dense, ids);
+            count_relations(poset);
         }
     }
 }
@@ -74,53 +353,444 @@ std::string quoted_or_null(const char *str) {
 }
 
 void assert_poset_contains_ids(Poset const &poset, ID name1_id, ID name2_id) {
-    assert_contains(std::get<NORMAL>(poset), name1_id);
-    assert_contains(std::get<REVERSED>(poset), name1_id);
-    assert_contains(std::get<NORMAL>(poset), name2_id);
-    assert_contains(std::get<REVERSED>(poset), name2_id);
+    if (debug) {
+        if (name1_id >= std::get<NEXT_FREE_SPOT>(poset) ||
+            name2_id >= std::get<NEXT_FREE_SPOT>(poset)) {
+            ERROR("poset doesn't hold element");
+        }
+    }
 }
 
-void add_relation_unchecked(Poset &poset, ID name1_id, ID name2_id) {
-    INFO("calling with args: ", name1_id, ", ", name2_id);
-    assert_poset_contains_ids(poset, name1_id, name2_id);
-    NeighbourSet &uppers = std::get<NORMAL>(poset)[name2_id];
-    uppers.insert(name1_id);
-    NeighbourSet &lowers = std::get<REVERSED>(poset)[name1_id];
-    lowers.insert(name2_id);
+ID new_element_id(Poset &poset) {
+    std::vector<ID> &free_spots = std::get<FREE_SPOTS>(poset);
+    if (!free_spots.empty()) {
+        ID id = free_spots.back();
+        free_spots.pop_back();
+        return id;
+    }
+    ID id = std::get<NEXT_FREE_SPOT>(poset)++;
+    // after poset_clear the slots are kept to keep their generations
+    if (id >= std::get<SLOTS>(poset).size()) {
+        std::get<SLOTS>(poset).emplace_back();
+    }
+    std::visit(
+        [&](auto &closure) {
+            reserve_id(closure[NORMAL], id);
+            reserve_id(closure[REVERSED], id);
+        },
+        std::get<CLOSURE>(poset));
+    return id;
+}
+
+void retire(Slot &slot) {
+    slot.name = nullptr;
+    // generation 0 would make handle 0 valid
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+}
+
+// Unlinks the element from every relation, forgets its name and frees its id;
+// its own rows are left empty for the next element that gets the id.
+void remove_element(Poset &poset, ID name_id) {
+    std::visit(
+        [&](auto &closure) {
+            auto &normal = closure[NORMAL];
+            auto &reversed = closure[REVERSED];
+            forget_relations(poset, row_size(normal, name_id) +
+                                        row_size(reversed, name_id));
+            for_each(normal, name_id,
+                     [&](ID lower) { clear(reversed, lower, name_id); });
+            for_each(reversed, name_id,
+                     [&](ID upper) { clear(normal, upper, name_id); });
+            clear_row(normal, name_id);
+            clear_row(reversed, name_id);
+        },
+        std::get<CLOSURE>(poset));
+    Slot &slot = std::get<SLOTS>(poset)[name_id];
+    NameToId &names = std::get<NAMES>(poset);
+    names.erase(names.find(*slot.name));
+    retire(slot);
+    std::get<FREE_SPOTS>(poset).push_back(name_id);
+    adapt_storage(poset);
 }
 
 void del_relation_unchecked(Poset &poset, ID name1_id, ID name2_id) {
     INFO("calling with args: ", name1_id, ", ", name2_id);
     assert_poset_contains_ids(poset, name1_id, name2_id);
-    NeighbourSet &uppers = std::get<NORMAL>(poset).at(name2_id);
-    uppers.erase(name1_id);
-    NeighbourSet &lowers = std::get<REVERSED>(poset).at(name1_id);
-    lowers.erase(name2_id);
+    std::visit(
+        [&](auto &closure) {
+            clear(closure[NORMAL], name2_id, name1_id);
+            clear(closure[REVERSED], name1_id, name2_id);
+        },
+        std::get<CLOSURE>(poset));
+    forget_relations(poset, 1);
 }
 
 bool test_relation_unchecked(Poset const &poset, ID name1_id, ID name2_id) {
     INFO("calling with args: ", name1_id, ", ", name2_id);
     assert_poset_contains_ids(poset, name1_id, name2_id);
-    NeighbourSet const &uppers = std::get<NORMAL>(poset).at(name2_id);
-    if (debug) {
-        NeighbourSet const &lowers = std::get<REVERSED>(poset).at(name1_id);
-        if (lowers.count(name2_id) != uppers.count(name1_id)) {
-            ERROR("REVERSED is not the reverse of NORMAL");
-        }
+    return std::visit(
+        [&](auto const &closure) {
+            bool lower = test(closure[NORMAL], name2_id, name1_id);
+            if (debug) {
+                bool upper = test(closure[REVERSED], name1_id, name2_id);
+                if (lower != upper) {
+                    ERROR("REVERSED is not the reverse of NORMAL");
+                }
+            }
+            return lower;
+        },
+        std::get<CLOSURE>(poset));
+}
+
+// Adds name1 < name2 and closes transitivity: everything below name1 (and
+// name1 itself) goes below everything above name2 (and name2 itself). Each
+// step merges one row into another. The two elements must not be in a
+// relation yet. Returns the number of new relations, or a lower bound for bit
+// matrices.
+template <typename Rows>
+size_t close_relation(Closure<Rows> &closure, ID name1_id, ID name2_id) {
+    auto &normal = closure[NORMAL];
+    auto &reversed = closure[REVERSED];
+    size_t added = 0;
+    // name1 is not above name2, so the rows of name1 in NORMAL and of name2 in
+    // REVERSED do not change while they are being merged
+    auto add_lowers = [&](ID upper) {
+        added += merge_rows(normal, upper, name1_id);
+        added += set(normal, upper, name1_id);
+    };
+    auto add_uppers = [&](ID lower) {
+        merge_rows(reversed, lower, name2_id);
+        set(reversed, lower, name2_id);
+    };
+    for_each(reversed, name2_id, add_lowers);
+    add_lowers(name2_id);
+    for_each(normal, name1_id, add_uppers);
+    add_uppers(name1_id);
+    return added;
+}
+
+void add_relation_closed(Poset &poset, ID name1_id, ID name2_id) {
+    INFO("calling with args: ", name1_id, ", ", name2_id);
+    assert_poset_contains_ids(poset, name1_id, name2_id);
+    std::visit(
+        [&](auto &closure) {
+            std::get<RELATION_COUNT>(poset) +=
+                close_relation(closure, name1_id, name2_id);
+        },
+        std::get<CLOSURE>(poset));
+}
+
+const ID NO_ID = ~ID{0};
+
+ID find_id(NameToId const &names, char const *value) {
+    if (value == nullptr) {
+        return NO_ID;
     }
-    return static_cast<bool>(uppers.count(name1_id));
+    auto name_iter = names.find(value);
+    return name_iter == names.end() ? NO_ID : name_iter->second;
 }
 
 bool in_between(Poset const &poset, ID name1_id, ID name2_id) {
     assert_poset_contains_ids(poset, name1_id, name2_id);
-    NeighbourSet const &uppers = std::get<NORMAL>(poset).at(name2_id);
-    for (auto upper : uppers) {
-        if (upper != name1_id and
-            test_relation_unchecked(poset, name1_id, upper)) {
-            return true;
+    return std::visit(
+        [&](auto const &closure) {
+            return rows_intersect(closure[REVERSED], name1_id, closure[NORMAL],
+                                  name2_id);
+        },
+        std::get<CLOSURE>(poset));
+}
+
+bool add_relation(Poset &poset, ID name1_id, ID name2_id) {
+    if (test_relation_unchecked(poset, name1_id, name2_id) ||
+        test_relation_unchecked(poset, name2_id, name1_id) ||
+        name1_id == name2_id) {
+        INFO("vertices are already in a relation");
+        return false;
+    }
+    add_relation_closed(poset, name1_id, name2_id);
+    adapt_storage(poset);
+    return true;
+}
+
+bool del_relation(Poset &poset, ID name1_id, ID name2_id) {
+    if (name1_id == name2_id) {
+        INFO("deleting would break reflexivity");
+        return false;
+    }
+    if (!test_relation_unchecked(poset, name1_id, name2_id)) {
+        INFO("vertices are not in relation");
+        return false;
+    }
+    if (in_between(poset, name1_id, name2_id)) {
+        INFO("deleting would break transitivity");
+        return false;
+    }
+    del_relation_unchecked(poset, name1_id, name2_id);
+    adapt_storage(poset);
+    return true;
+}
+
+bool test_relation(Poset const &poset, ID name1_id, ID name2_id) {
+    return name1_id == name2_id or
+           test_relation_unchecked(poset, name1_id, name2_id);
+}
+
+Handle make_handle(Poset const &poset, ID name_id) {
+    return Handle{std::get<SLOTS>(poset)[name_id].generation} << SLOT_BITS |
+           name_id;
+}
+
+// Returns false for handles of removed elements, of cleared posets and for
+// values that were never handles.
+bool resolve(Poset const &poset, Handle handle, ID &name_id) {
+    name_id = handle & ((Handle{1} << SLOT_BITS) - 1);
+    std::vector<Slot> const &slots = std::get<SLOTS>(poset);
+    if (name_id >= slots.size() || slots[name_id].name == nullptr ||
+        slots[name_id].generation != handle >> SLOT_BITS) {
+        INFO("stale or invalid handle=", handle);
+        return false;
+    }
+    return true;
+}
+
+// Direct uppers of every element of an edge list, in compressed form: the
+// uppers of element a are uppers[first[a]] to uppers[first[a + 1] - 1].
+struct EdgeList {
+    std::vector<size_t> first;
+    std::vector<ID> uppers;
+};
+
+EdgeList edge_list(size_t elements, size_t const *edges, size_t count) {
+    EdgeList list = {std::vector<size_t>(elements + 1),
+                     std::vector<ID>(count)};
+    for (size_t i = 0; i < count; ++i) {
+        ++list.first[edges[2 * i] + 1];
+    }
+    std::partial_sum(list.first.begin(), list.first.end(), list.first.begin());
+    std::vector<size_t> next(list.first.begin(), list.first.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        list.uppers[next[edges[2 * i]]++] = edges[2 * i + 1];
+    }
+    return list;
+}
+
+// Kahn's algorithm: every element comes after all its lowers. Elements on
+// a cycle, or above one, never get there, so the order is then incomplete.
+std::vector<ID> topological_order(EdgeList const &list, size_t elements) {
+    std::vector<size_t> lowers_left(elements);
+    for (ID upper : list.uppers) {
+        ++lowers_left[upper];
+    }
+    std::vector<ID> order;
+    order.reserve(elements);
+    for (ID id = 0; id < elements; ++id) {
+        if (lowers_left[id] == 0) {
+            order.push_back(id);
         }
     }
-    return false;
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (size_t j = list.first[order[i]]; j < list.first[order[i] + 1];
+             ++j) {
+            if (--lowers_left[list.uppers[j]] == 0) {
+                order.push_back(list.uppers[j]);
+            }
+        }
+    }
+    return order;
+}
+
+// Fills the NORMAL rows going through the order from position done. Once an
+// element is reached its row is final, as all its lowers came before, and it
+// goes with that row into the rows of its direct uppers. Counts the relations
+// of the final rows and stops after the row that brings them to limit.
+// Returns the position it stopped at.
+template <typename Rows>
+size_t close_rows(Rows &normal, EdgeList const &list,
+                  std::vector<ID> const &order, size_t done, size_t &relations,
+                  size_t limit) {
+    while (done < order.size() && relations < limit) {
+        ID lower = order[done++];
+        relations += row_size(normal, lower);
+        for (size_t j = list.first[lower]; j < list.first[lower + 1]; ++j) {
+            merge_rows(normal, list.uppers[j], lower);
+            set(normal, list.uppers[j], lower);
+        }
+    }
+    return done;
+}
+
+// Builds the closure of a DAG in one pass over a topological order, instead of
+// closing it after every edge. Starts with sorted lists and moves to bit
+// matrices as soon as the rows done so far reach the density at which
+// adapt_storage would switch. REVERSED is filled the same way, going backwards
+// through the order: an element takes the rows of its direct uppers.
+void close_edges(Poset &poset, EdgeList const &list,
+                 std::vector<ID> const &order) {
+    Thresholds const &t = thresholds();
+    size_t elements = order.size();
+    size_t limit = elements >= t.min_dense_size
+                       ? static_cast<size_t>(t.dense_density * elements *
+                                             elements)
+                       : SIZE_MAX;
+    Storage &storage = std::get<CLOSURE>(poset);
+    size_t &relations = std::get<RELATION_COUNT>(poset);
+    auto &sparse = std::get<Closure<SortedLists>>(storage);
+    for (Direction direction : {NORMAL, REVERSED}) {
+        if (elements > 0) {
+            reserve_id(sparse[direction], elements - 1);
+        }
+    }
+    size_t done = close_rows(sparse[NORMAL], list, order, 0, relations, limit);
+    if (done < elements) {
+        INFO("switching to bit matrices, elements=", elements);
+        storage = convert<BitMatrix>(sparse, elements);
+        close_rows(std::get<Closure<BitMatrix>>(storage)[NORMAL], list, order,
+                   done, relations, SIZE_MAX);
+    }
+    std::visit(
+        [&](auto &closure) {
+            for (size_t i = elements; i-- > 0;) {
+                ID lower = order[i];
+                for (size_t j = list.first[lower]; j < list.first[lower + 1];
+                     ++j) {
+                    merge_rows(closure[REVERSED], lower, list.uppers[j]);
+                    set(closure[REVERSED], lower, list.uppers[j]);
+                }
+            }
+        },
+        storage);
+}
+
+// The closure restricted to the elements a batch of additions names, with the
+// relations the batch has accepted so far. It decides each pair the way the
+// single calls made in order would, while the closure of the poset stays as
+// it was until close_batch applies the whole batch.
+struct BatchClosure {
+    std::unordered_map<ID, ID> local_ids; // element id -> local id
+    std::vector<ID> elements;             // local id -> element id
+    Closure<BitMatrix> closure;
+};
+
+// An element that joins the batch gets the local lowers (and uppers) of every
+// element it is below (above) in the poset: every relation through accepted
+// edges passes through elements of the batch.
+ID local_id(Poset const &poset, BatchClosure &batch, ID name_id) {
+    auto [local_it, inserted] =
+        batch.local_ids.emplace(name_id, batch.elements.size());
+    ID local = local_it->second;
+    if (!inserted) {
+        return local;
+    }
+    batch.elements.push_back(name_id);
+    auto &normal = batch.closure[NORMAL];
+    auto &reversed = batch.closure[REVERSED];
+    reserve_id(normal, local);
+    reserve_id(reversed, local);
+    auto join = [&](auto &rows, ID other) {
+        merge_rows(rows, local, other);
+        set(rows, local, other);
+    };
+    std::visit(
+        [&](auto const &closure) {
+            // whichever is shorter: the rows of the element in the poset or
+            // the elements of the batch
+            if (row_size(closure[NORMAL], name_id) +
+                    row_size(closure[REVERSED], name_id) <
+                local) {
+                for (Direction direction : {NORMAL, REVERSED}) {
+                    auto &rows = direction == NORMAL ? normal : reversed;
+                    for_each(closure[direction], name_id, [&](ID other_id) {
+                        auto other_it = batch.local_ids.find(other_id);
+                        if (other_it != batch.local_ids.end()) {
+                            join(rows, other_it->second);
+                        }
+                    });
+                }
+                return;
+            }
+            for (ID other = 0; other < local; ++other) {
+                ID other_id = batch.elements[other];
+                if (test(closure[NORMAL], name_id, other_id)) {
+                    join(normal, other);
+                } else if (test(closure[NORMAL], other_id, name_id)) {
+                    join(reversed, other);
+                }
+            }
+        },
+        std::get<CLOSURE>(poset));
+    for_each(normal, local, [&](ID lower) { set(reversed, lower, local); });
+    for_each(reversed, local, [&](ID upper) { set(normal, upper, local); });
+    return local;
+}
+
+// Goes through the elements of the batch from local id done. Each takes the
+// rows of its local lowers, which bring along the old lowers of theirs, and
+// then passes its finished row on to the elements above it in the poset. Rows
+// of the batch do not depend on which ones are already done, so it can stop
+// once relations reach limit and go on in the other representation. Returns
+// the local id it stopped at.
+template <typename Rows>
+size_t close_batch_rows(Rows &rows, Rows const &transposed,
+                        BatchClosure const &batch, Direction direction,
+                        size_t done, size_t &relations, size_t limit) {
+    while (done < batch.elements.size() && relations < limit) {
+        ID local = done++;
+        ID name_id = batch.elements[local];
+        bool changed = false;
+        for_each(batch.closure[direction], local, [&](ID other) {
+            ID other_id = batch.elements[other];
+            if (!test(rows, name_id, other_id)) {
+                relations += merge_rows(rows, name_id, other_id);
+                relations += set(rows, name_id, other_id);
+                changed = true;
+            }
+        });
+        if (changed) {
+            for_each(transposed, name_id, [&](ID outer) {
+                relations += merge_rows(rows, outer, name_id);
+            });
+        }
+    }
+    return done;
+}
+
+// Adds the relations accepted by a batch to the closure in one pass over the
+// elements of the batch instead of closing it after every pair. Like
+// close_edges, it moves to bit matrices as soon as the relations reach the
+// density at which adapt_storage would switch.
+void close_batch(Poset &poset, BatchClosure const &batch) {
+    Thresholds const &t = thresholds();
+    size_t elements = std::get<NAMES>(poset).size();
+    size_t limit = elements >= t.min_dense_size
+                       ? static_cast<size_t>(t.dense_density * elements *
+                                             elements)
+                       : SIZE_MAX;
+    Storage &storage = std::get<CLOSURE>(poset);
+    size_t &relations = std::get<RELATION_COUNT>(poset);
+    size_t done = 0;
+    if (auto *sparse = std::get_if<Closure<SortedLists>>(&storage)) {
+        done = close_batch_rows((*sparse)[NORMAL], (*sparse)[REVERSED], batch,
+                                NORMAL, 0, relations, limit);
+        if (done < batch.elements.size()) {
+            INFO("switching to bit matrices, elements=", elements);
+            storage = convert<BitMatrix>(*sparse,
+                                         std::get<NEXT_FREE_SPOT>(poset));
+        }
+    }
+    if (auto *dense = std::get_if<Closure<BitMatrix>>(&storage)) {
+        close_batch_rows((*dense)[NORMAL], (*dense)[REVERSED], batch, NORMAL,
+                         done, relations, SIZE_MAX);
+    }
+    // only NORMAL counts relations
+    size_t uncounted = 0;
+    std::visit(
+        [&](auto &closure) {
+            close_batch_rows(closure[REVERSED], closure[NORMAL], batch,
+                             REVERSED, 0, uncounted, SIZE_MAX);
+        },
+        storage);
 }
 } // namespace
 
@@ -166,16 +836,17 @@ bool poset_insert(ID id, char const *value) {
     }
 
     Poset &p = it->second;
-    if (std::get<NAMES>(p).count(value) > 0) {
+    auto [name_it, inserted] = std::get<NAMES>(p).emplace(value, ID{});
+    if (!inserted) {
         INFO("poset already contains value=\"", value);
         RETURNS(false);
         return false;
     }
-    ID &free = std::get<NEXT_FREE_SPOT>(p);
+    ID free = new_element_id(p);
     INFO("value \"", value, "\" gets id=", free);
-    std::get<NORMAL>(p)[free] = {};
-    std::get<REVERSED>(p)[free] = {};
-    std::get<NAMES>(p)[value] = free++;
+    name_it->second = free;
+    std::get<SLOTS>(p)[free].name = &name_it->first;
+    adapt_storage(p);
     RETURNS(true);
     return true;
 }
@@ -199,16 +870,7 @@ bool poset_remove(ID id, char const *value) {
         RETURNS(false);
         return false;
     }
-    ID name_id = name_iter->second;
-    NeighbourSet uppers = std::get<NORMAL>(poset).at(name_id);
-    for (auto upper : uppers)
-        del_relation_unchecked(poset, upper, name_id);
-    NeighbourSet lowers = std::get<REVERSED>(poset).at(name_id);
-    for (auto lower : lowers)
-        del_relation_unchecked(poset, name_id, lower);
-    std::get<NAMES>(poset).erase(value);
-    std::get<NORMAL>(poset).erase(name_id);
-    std::get<REVERSED>(poset).erase(name_id);
+    remove_element(poset, name_iter->second);
     RETURNS(true);
     return true;
 }
@@ -229,35 +891,15 @@ bool poset_add(ID id, char const *value1, char const *value2) {
     }
     Poset &poset = poset_it->second;
     NameToId const &names = std::get<NAMES>(poset);
-    if (names.count(value1) == 0 || names.count(value2) == 0) {
+    auto name1 = names.find(value1), name2 = names.find(value2);
+    if (name1 == names.end() || name2 == names.end()) {
         INFO("one of the vertices doesn't exist");
         RETURNS(false);
         return false;
     }
-    ID name1_id = names.at(value1);
-    ID name2_id = names.at(value2);
-    if (test_relation_unchecked(poset, name1_id, name2_id) ||
-        test_relation_unchecked(poset, name2_id, name1_id) ||
-        name1_id == name2_id) {
-        INFO("vertices are already in a relation");
-        RETURNS(false);
-        return false;
-    }
-    add_relation_unchecked(poset, name1_id, name2_id);
-    NeighbourSet &uppers = std::get<NORMAL>(poset).at(name1_id);
-    NeighbourSet &lowers = std::get<REVERSED>(poset).at(name2_id);
-    for (auto lower_it : lowers) {
-        for (auto upper_it : uppers)
-            add_relation_unchecked(poset, upper_it, lower_it);
-    }
-    for (auto lower_it : lowers) {
-        add_relation_unchecked(poset, name1_id, lower_it);
-    }
-    for (auto upper_it : uppers) {
-        add_relation_unchecked(poset, upper_it, name2_id);
-    }
-    RETURNS(true);
-    return true;
+    bool ret = add_relation(poset, name1->second, name2->second);
+    RETURNS(ret);
+    return ret;
 }
 
 bool poset_del(ID id, char const *value1, char const *value2) {
@@ -276,30 +918,14 @@ bool poset_del(ID id, char const *value1, char const *value2) {
     }
     Poset &poset = poset_it->second;
     NameToId const &names = std::get<NAMES>(poset);
-    if (names.count(value1) == 0 || names.count(value2) == 0) {
+    auto name1 = names.find(value1), name2 = names.find(value2);
+    if (name1 == names.end() || name2 == names.end()) {
         RETURNS(false);
         return false;
     }
-    ID name1_id = names.at(value1);
-    ID name2_id = names.at(value2);
-    if (name1_id == name2_id) {
-        INFO("deleting would break reflexivity");
-        RETURNS(false);
-        return false;
-    }
-    if (!test_relation_unchecked(poset, name1_id, name2_id)) {
-        INFO("vertices are not in relation");
-        RETURNS(false);
-        return false;
-    }
-    if (in_between(poset, name1_id, name2_id)) {
-        INFO("deleting would break transitivity");
-        RETURNS(false);
-        return false;
-    }
-    del_relation_unchecked(poset, name1_id, name2_id);
-    RETURNS(true);
-    return true;
+    bool ret = del_relation(poset, name1->second, name2->second);
+    RETURNS(ret);
+    return ret;
 }
 
 bool poset_test(ID id, char const *value1, char const *value2) {
@@ -317,15 +943,13 @@ bool poset_test(ID id, char const *value1, char const *value2) {
     }
     Poset const &poset = poset_it->second;
     NameToId const &names = std::get<NAMES>(poset);
-    if (names.count(value1) == 0 || names.count(value2) == 0) {
+    auto name1 = names.find(value1), name2 = names.find(value2);
+    if (name1 == names.end() || name2 == names.end()) {
         INFO("poset (id=", id, ") doesn't hold either of the values");
         RETURNS(false);
         return false;
     }
-    ID name1_id = names.at(value1);
-    ID name2_id = names.at(value2);
-    bool ret = std::string{value1} == std::string{value2} or
-               test_relation_unchecked(poset, name1_id, name2_id);
+    bool ret = test_relation(poset, name1->second, name2->second);
     RETURNS(ret);
     return ret;
 }
@@ -334,11 +958,281 @@ void poset_clear(ID id) {
     INFO("id=", id);
     if (posets().count(id) != 0) {
         Poset &poset = posets().at(id);
-        std::get<NORMAL>(poset).clear();
-        std::get<REVERSED>(poset).clear();
-        std::get<NAMES>(poset).clear();
+        std::vector<Slot> slots = std::move(std::get<SLOTS>(poset));
+        for (Slot &slot : slots) {
+            retire(slot);
+        }
+        poset = {};
+        std::get<SLOTS>(poset) = std::move(slots);
     } else {
         POSET_NOT_FOUND(id);
     }
 }
+
+Handle poset_lookup(ID id, char const *value) {
+    INFO("id=", id, ", value=", quoted_or_null(value));
+    if (value == nullptr) {
+        INFO("invalid value: nullptr");
+        RETURNS(0);
+        return 0;
+    }
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(0);
+        return 0;
+    }
+    Poset const &poset = poset_it->second;
+    auto name_iter = std::get<NAMES>(poset).find(value);
+    if (name_iter == std::get<NAMES>(poset).end()) {
+        RETURNS(0);
+        return 0;
+    }
+    Handle handle = make_handle(poset, name_iter->second);
+    RETURNS(handle);
+    return handle;
+}
+
+bool poset_remove_h(ID id, Handle value) {
+    INFO("id=", id, ", value=", value);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(false);
+        return false;
+    }
+    Poset &poset = poset_it->second;
+    ID name_id;
+    if (!resolve(poset, value, name_id)) {
+        RETURNS(false);
+        return false;
+    }
+    remove_element(poset, name_id);
+    RETURNS(true);
+    return true;
+}
+
+bool poset_add_h(ID id, Handle value1, Handle value2) {
+    INFO("id=", id, ", value1=", value1, ", value2=", value2);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(false);
+        return false;
+    }
+    Poset &poset = poset_it->second;
+    ID name1_id, name2_id;
+    if (!resolve(poset, value1, name1_id) ||
+        !resolve(poset, value2, name2_id)) {
+        RETURNS(false);
+        return false;
+    }
+    bool ret = add_relation(poset, name1_id, name2_id);
+    RETURNS(ret);
+    return ret;
+}
+
+bool poset_del_h(ID id, Handle value1, Handle value2) {
+    INFO("id=", id, ", value1=", value1, ", value2=", value2);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(false);
+        return false;
+    }
+    Poset &poset = poset_it->second;
+    ID name1_id, name2_id;
+    if (!resolve(poset, value1, name1_id) ||
+        !resolve(poset, value2, name2_id)) {
+        RETURNS(false);
+        return false;
+    }
+    bool ret = del_relation(poset, name1_id, name2_id);
+    RETURNS(ret);
+    return ret;
+}
+
+bool poset_test_h(ID id, Handle value1, Handle value2) {
+    INFO("id=", id, ", value1=", value1, ", value2=", value2);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        return false;
+    }
+    Poset const &poset = poset_it->second;
+    ID name1_id, name2_id;
+    if (!resolve(poset, value1, name1_id) ||
+        !resolve(poset, value2, name2_id)) {
+        RETURNS(false);
+        return false;
+    }
+    bool ret = test_relation(poset, name1_id, name2_id);
+    RETURNS(ret);
+    return ret;
+}
+
+bool poset_get_stats(ID id, struct poset_stats *stats) {
+    INFO("id=", id);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end() || stats == nullptr) {
+        POSET_NOT_FOUND(id);
+        RETURNS(false);
+        return false;
+    }
+    Poset &poset = poset_it->second;
+    stats->elements = std::get<NAMES>(poset).size();
+    stats->relations = count_relations(poset);
+    stats->dense =
+        std::holds_alternative<Closure<BitMatrix>>(std::get<CLOSURE>(poset));
+    INFO("elements=", stats->elements, ", relations=", stats->relations,
+         ", dense=", stats->dense);
+    RETURNS(true);
+    return true;
+}
+
+bool poset_set_thresholds(size_t min_dense_size, double dense_density,
+                          double sparse_density) {
+    INFO("min_dense_size=", min_dense_size, ", dense_density=", dense_density,
+         ", sparse_density=", sparse_density);
+    if (!(0 <= sparse_density && sparse_density <= dense_density &&
+          dense_density <= 1)) {
+        INFO("invalid densities");
+        RETURNS(false);
+        return false;
+    }
+    thresholds() = {min_dense_size, dense_density, sparse_density};
+    // existing posets switch representation at their next change
+    RETURNS(true);
+    return true;
+}
+
+size_t poset_test_batch(ID id, char const *const *pairs, size_t count,
+                        bool *results) {
+    INFO("id=", id, ", count=", count);
+    if (results == nullptr || (count > 0 && pairs == nullptr)) {
+        INFO("invalid arrays: nullptr");
+        RETURNS(0);
+        return 0;
+    }
+    std::fill(results, results + count, false);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(0);
+        return 0;
+    }
+    Poset const &poset = poset_it->second;
+    NameToId const &names = std::get<NAMES>(poset);
+    size_t ret = 0;
+    std::visit(
+        [&](auto const &closure) {
+            for (size_t i = 0; i < count; ++i) {
+                ID name1_id = find_id(names, pairs[2 * i]);
+                ID name2_id = find_id(names, pairs[2 * i + 1]);
+                results[i] = name1_id != NO_ID && name2_id != NO_ID &&
+                             (name1_id == name2_id ||
+                              test(closure[NORMAL], name2_id, name1_id));
+                ret += results[i];
+            }
+        },
+        std::get<CLOSURE>(poset));
+    RETURNS(ret);
+    return ret;
+}
+
+size_t poset_add_batch(ID id, char const *const *pairs, size_t count,
+                       bool *results) {
+    INFO("id=", id, ", count=", count);
+    if (results == nullptr || (count > 0 && pairs == nullptr)) {
+        INFO("invalid arrays: nullptr");
+        RETURNS(0);
+        return 0;
+    }
+    std::fill(results, results + count, false);
+    auto poset_it = posets().find(id);
+    if (poset_it == posets().end()) {
+        POSET_NOT_FOUND(id);
+        RETURNS(0);
+        return 0;
+    }
+    Poset &poset = poset_it->second;
+    NameToId const &names = std::get<NAMES>(poset);
+    BatchClosure batch;
+    bool added = false;
+    for (size_t i = 0; i < count; ++i) {
+        ID name1_id = find_id(names, pairs[2 * i]);
+        ID name2_id = find_id(names, pairs[2 * i + 1]);
+        // the batch only adds relations, so related elements stay related
+        if (name1_id == NO_ID || name2_id == NO_ID || name1_id == name2_id ||
+            test_relation_unchecked(poset, name1_id, name2_id) ||
+            test_relation_unchecked(poset, name2_id, name1_id)) {
+            continue;
+        }
+        ID local1 = local_id(poset, batch, name1_id);
+        ID local2 = local_id(poset, batch, name2_id);
+        auto const &lowers = batch.closure[NORMAL];
+        if (test(lowers, local2, local1) || test(lowers, local1, local2)) {
+            continue;
+        }
+        close_relation(batch.closure, local1, local2);
+        results[i] = added = true;
+    }
+    if (added) {
+        close_batch(poset, batch);
+        adapt_storage(poset);
+    }
+    size_t ret = std::count(results, results + count, true);
+    RETURNS(ret);
+    return ret;
+}
+
+bool poset_from_edges(char const *const *names, size_t names_count,
+                      size_t const *edges, size_t edges_count, ID *id) {
+    INFO("names_count=", names_count, ", edges_count=", edges_count);
+    if (id == nullptr || (names_count > 0 && names == nullptr) ||
+        (edges_count > 0 && edges == nullptr)) {
+        INFO("invalid arrays: nullptr");
+        RETURNS(false);
+        return false;
+    }
+    for (size_t i = 0; i < 2 * edges_count; ++i) {
+        if (edges[i] >= names_count) {
+            INFO("edge ", i / 2, " refers to name ", edges[i]);
+            RETURNS(false);
+            return false;
+        }
+    }
+    Poset poset = {};
+    NameToId &name_ids = std::get<NAMES>(poset);
+    std::vector<Slot> &slots = std::get<SLOTS>(poset);
+    slots.resize(names_count);
+    for (ID name_id = 0; name_id < names_count; ++name_id) {
+        if (names[name_id] == nullptr) {
+            INFO("invalid value: nullptr");
+            RETURNS(false);
+            return false;
+        }
+        auto [name_it, inserted] = name_ids.emplace(names[name_id], name_id);
+        if (!inserted) {
+            INFO("repeated value=\"", names[name_id], "\"");
+            RETURNS(false);
+            return false;
+        }
+        slots[name_id].name = &name_it->first;
+    }
+    std::get<NEXT_FREE_SPOT>(poset) = names_count;
+    EdgeList list = edge_list(names_count, edges, edges_count);
+    std::vector<ID> order = topological_order(list, names_count);
+    if (order.size() < names_count) {
+        INFO("edges have a cycle");
+        RETURNS(false);
+        return false;
+    }
+    close_edges(poset, list, order);
+    adapt_storage(poset);
+    *id = poset_new();
+    posets()[*id] = std::move(poset);
+    RETURNS(true);
+    return true;
+}
 } // namespace jnp1
@@ -8,6 +8,18 @@ extern "C" {
 #include <stdbool.h>
 #include <stddef.h>
 #endif
+// Storage of a poset: sorted lists for small or sparse ones, bit matrices for
+// the others; relations counts pairs of different related elements.
+struct poset_stats {
+    size_t elements;
+    size_t relations;
+    bool dense;
+};
+// A handle names an element of one poset without hashing the name on every
+// call. It goes stale when the element is removed or the poset is cleared, and
+// the _h functions then fail as if the element did not exist. 0 is never
+// a valid handle.
+typedef unsigned long long poset_handle;
 unsigned long poset_new(void);
 void poset_delete(unsigned long id);
 size_t poset_size(unsigned long id);
@@ -17,6 +29,32 @@ bool poset_add(unsigned long id, char const *value1, char const *value2);
 bool poset_del(unsigned long id, char const *value1, char const *value2);
 bool poset_test(unsigned long id, char const *value1, char const *value2);
 void poset_clear(unsigned long id);
+poset_handle poset_lookup(unsigned long id, char const *value);
+bool poset_remove_h(unsigned long id, poset_handle value);
+bool poset_add_h(unsigned long id, poset_handle value1, poset_handle value2);
+bool poset_del_h(unsigned long id, poset_handle value1, poset_handle value2);
+bool poset_test_h(unsigned long id, poset_handle value1, poset_handle value2);
+// pairs holds count pairs of values: pairs[2 * i] and pairs[2 * i + 1].
+// results[i] is set to what the i-th of the corresponding single calls, made
+// in order, would return. Both return the number of true results.
+size_t poset_test_batch(unsigned long id, char const *const *pairs,
+                        size_t count, bool *results);
+size_t poset_add_batch(unsigned long id, char const *const *pairs, size_t count,
+                       bool *results);
+// Creates a poset of the names in which names[edges[2 * i]] is below
+// names[edges[2 * i + 1]] for each of the edges_count edges, and stores its id
+// in *id. Fails without creating anything if a name is null or repeated, an
+// edge refers to a name that is not there, or the edges have a cycle.
+bool poset_from_edges(char const *const *names, size_t names_count,
+                      size_t const *edges, size_t edges_count,
+                      unsigned long *id);
+bool poset_get_stats(unsigned long id, struct poset_stats *stats);
+// A poset with at least min_dense_size elements switches to bit matrices once
+// dense_density of all element pairs are related, and back to sorted lists
+// below sparse_density. Returns false unless
+// 0 <= sparse_density <= dense_density <= 1.
+bool poset_set_thresholds(size_t min_dense_size, double dense_density,
+                          double sparse_density);
 #ifdef __cplusplus
 }
 }
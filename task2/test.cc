@@ -0,0 +1,496 @@
+// Checks the newer poset calls against the original ones: every operation is
+// made with a new call on one poset and with the original calls on another,
+// and the two must agree on every result, every relation and their stats.
+// Each test also runs under thresholds low enough that the storage becomes,
+// or keeps switching between, bit matrices and sorted lists. TEST 4 checks the
+// stats and the thresholds themselves on a chain.
+//
+//   g++ -std=c++17 -O2 -DNDEBUG poset.cc test.cc -o test && ./test
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "poset.h"
+
+using namespace jnp1;
+
+namespace {
+struct thresholds {
+    char const *name;
+    size_t min_dense_size;
+    double dense_density;
+    double sparse_density;
+};
+
+// The first entry is the default of poset.cc.
+thresholds const settings[] = {
+    {"default", 64, 1.0 / 256, 1.0 / 1024},
+    {"always dense", 0, 0, 0},
+    {"switching", 2, 0.05, 0.05},
+};
+
+int failures = 0;
+
+void check(bool ok, std::string const &what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "FAIL " << what << "\n";
+    }
+}
+
+std::vector<std::string> make_names(size_t count) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back("n" + std::to_string(i));
+    }
+    return names;
+}
+
+// Both posets relate the same pairs of names and have the same stats.
+bool same_posets(unsigned long p, unsigned long q,
+                 std::vector<std::string> const &names) {
+    for (std::string const &a : names) {
+        for (std::string const &b : names) {
+            if (poset_test(p, a.c_str(), b.c_str()) !=
+                poset_test(q, a.c_str(), b.c_str())) {
+                return false;
+            }
+        }
+    }
+    poset_stats ps, qs;
+    return poset_get_stats(p, &ps) && poset_get_stats(q, &qs) &&
+           ps.elements == qs.elements && ps.relations == qs.relations;
+}
+
+// Random operations through handles on one poset and through names on the
+// other. Handles are looked up again now and then and otherwise kept, so some
+// of them outlive their element or a clear and must then fail.
+void compare_handles(thresholds const &t, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<std::string> names = make_names(30);
+    unsigned long p = poset_new(), q = poset_new();
+    std::vector<poset_handle> handles(names.size(), 0);
+    std::vector<bool> valid(names.size(), false);
+    bool dense = false;
+    size_t compared = 0, stale = 0, switches = 0;
+    for (int i = 0; i < 20000; ++i) {
+        std::string const at =
+            std::string(t.name) + ", operation " + std::to_string(i);
+        size_t a = random() % names.size(), b = random() % names.size();
+        for (size_t x : {a, b}) {
+            if (!valid[x] || random() % 4 == 0) {
+                handles[x] = poset_lookup(p, names[x].c_str());
+                valid[x] = handles[x] != 0;
+                check(valid[x] == poset_test(q, names[x].c_str(),
+                                             names[x].c_str()),
+                      "lookup, " + at);
+            }
+        }
+        unsigned op = random() % 100;
+        if (op < 20) {
+            check(poset_insert(p, names[a].c_str()) ==
+                      poset_insert(q, names[a].c_str()),
+                  "insert, " + at);
+        } else if (op < 25) {
+            bool removed = poset_remove_h(p, handles[a]);
+            if (!valid[a]) {
+                check(!removed, "remove_h with a stale handle, " + at);
+                ++stale;
+            } else {
+                check(removed == poset_remove(q, names[a].c_str()),
+                      "remove_h, " + at);
+                ++compared;
+            }
+            valid[a] = false;
+        } else if (op < 99) {
+            unsigned kind = op % 3;
+            bool result = kind == 0   ? poset_add_h(p, handles[a], handles[b])
+                          : kind == 1 ? poset_del_h(p, handles[a], handles[b])
+                                      : poset_test_h(p, handles[a], handles[b]);
+            if (!valid[a] || !valid[b]) {
+                check(!result, "call with a stale handle, " + at);
+                ++stale;
+                continue;
+            }
+            char const *x = names[a].c_str(), *y = names[b].c_str();
+            bool expected = kind == 0   ? poset_add(q, x, y)
+                            : kind == 1 ? poset_del(q, x, y)
+                                        : poset_test(q, x, y);
+            check(result == expected, "add_h, del_h or test_h, " + at);
+            ++compared;
+        } else if (random() % 5 == 0) {
+            poset_clear(p);
+            poset_clear(q);
+            valid.assign(names.size(), false);
+        }
+        poset_stats stats;
+        poset_get_stats(p, &stats);
+        switches += stats.dense != dense;
+        dense = stats.dense;
+        if (i % 1000 == 0) {
+            check(same_posets(p, q, names), "relations, " + at);
+        }
+    }
+    check(same_posets(p, q, names), std::string("relations, ") + t.name);
+    // 0 is never a handle, and neither is a handle of a missing element
+    poset_insert(p, "x");
+    poset_handle x = poset_lookup(p, "x");
+    check(x != 0 && poset_test_h(p, x, x), "fresh handle");
+    check(poset_lookup(p, "missing") == 0 && poset_lookup(p, nullptr) == 0,
+          "lookup of a missing name");
+    check(!poset_test_h(p, 0, x) && !poset_add_h(p, x, 0), "handle 0");
+    unsigned long other = poset_new();
+    check(!poset_test_h(other, x, x), "handle of another poset");
+    poset_delete(other);
+    poset_remove(p, "x");
+    poset_insert(p, "x");
+    check(!poset_test_h(p, x, x) && poset_lookup(p, "x") != x,
+          "handle after the element came back");
+    poset_delete(p);
+    poset_delete(q);
+    check(!poset_test_h(p, x, x) && poset_lookup(p, "x") == 0,
+          "handle of a deleted poset");
+    std::cout << t.name << ": " << compared << " calls compared, " << stale
+              << " stale or missing handles rejected, " << switches
+              << " storage switches\n";
+}
+
+// Random batches of tests and additions on one poset and the same pairs made
+// one by one with the original calls on the other, interleaved with single
+// inserts, removals and deletions. Pairs may name unknown elements or be null.
+void compare_batches(thresholds const &t, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<std::string> names = make_names(45);
+    size_t const known = 40; // the remaining names are never inserted
+    unsigned long p = poset_new(), q = poset_new();
+    bool dense = false;
+    size_t batches = 0, pairs_compared = 0, switches = 0;
+    for (int i = 0; i < 5000; ++i) {
+        std::string const at =
+            std::string(t.name) + ", operation " + std::to_string(i);
+        char const *a = names[random() % known].c_str();
+        char const *b = names[random() % known].c_str();
+        unsigned op = random() % 100;
+        if (op < 40) {
+            check(poset_insert(p, a) == poset_insert(q, a), "insert, " + at);
+        } else if (op < 45) {
+            check(poset_remove(p, a) == poset_remove(q, a), "remove, " + at);
+        } else if (op < 50) {
+            check(poset_del(p, a, b) == poset_del(q, a, b), "del, " + at);
+        } else if (op < 51) {
+            poset_clear(p);
+            poset_clear(q);
+        } else {
+            // mostly short batches, with a long one now and then
+            size_t count = random() % (op < 95 ? 8 : 300);
+            std::vector<char const *> pairs(2 * count);
+            for (char const *&name : pairs) {
+                size_t n = random() % names.size();
+                name = random() % 40 == 0 ? nullptr : names[n].c_str();
+            }
+            bool add = op < 80;
+            // the results must be overwritten, whatever was there before
+            bool results[301];
+            std::fill(results, results + count + 1, true);
+            size_t returned =
+                add ? poset_add_batch(p, pairs.data(), count, results)
+                    : poset_test_batch(p, pairs.data(), count, results);
+            size_t expected = 0;
+            for (size_t j = 0; j < count; ++j) {
+                char const *x = pairs[2 * j], *y = pairs[2 * j + 1];
+                bool single = add ? poset_add(q, x, y) : poset_test(q, x, y);
+                check(results[j] == single,
+                      (add ? "add_batch, " : "test_batch, ") + at);
+                expected += single;
+            }
+            check(returned == expected, "batch count, " + at);
+            check(results[count], "batch wrote past its results, " + at);
+            ++batches;
+            pairs_compared += count;
+        }
+        poset_stats stats;
+        poset_get_stats(p, &stats);
+        switches += stats.dense != dense;
+        dense = stats.dense;
+        if (i % 500 == 0) {
+            check(same_posets(p, q, names), "relations, " + at);
+        }
+    }
+    check(same_posets(p, q, names), std::string("relations, ") + t.name);
+    // empty batches, missing arrays and missing posets add nothing
+    bool result = true;
+    char const *pair[] = {names[0].c_str(), names[1].c_str()};
+    check(poset_add_batch(p, pair, 0, &result) == 0 &&
+              poset_test_batch(p, nullptr, 0, &result) == 0,
+          "empty batch");
+    check(poset_add_batch(p, pair, 1, nullptr) == 0 &&
+              poset_add_batch(p, nullptr, 1, &result) == 0,
+          "batch without arrays");
+    poset_delete(p);
+    result = true;
+    check(poset_test_batch(p, pair, 1, &result) == 0 && !result,
+          "batch on a deleted poset");
+    check(same_posets(q, q, names), "reference poset");
+    poset_delete(q);
+    std::cout << t.name << ": " << batches << " batches, " << pairs_compared
+              << " pairs compared, " << switches << " storage switches\n";
+}
+// Fails, leaves *id alone and uses up no poset id.
+bool from_edges_fails(std::vector<char const *> const &names,
+                      std::vector<size_t> const &edges) {
+    unsigned long before = poset_new(), id = before;
+    bool created = poset_from_edges(names.data(), names.size(), edges.data(),
+                                    edges.size() / 2, &id);
+    unsigned long after = poset_new();
+    poset_delete(before);
+    poset_delete(after);
+    return !created && id == before && after == before + 1;
+}
+
+// Random graphs, most of them acyclic, built with poset_from_edges and with
+// poset_insert and poset_add edge by edge. The edge-by-edge build fails where
+// poset_from_edges has to: a repeated name, an edge closing a cycle or a
+// self-loop, an edge out of range.
+void compare_from_edges(thresholds const &t, unsigned seed) {
+    std::mt19937 random(seed);
+    size_t built = 0, rejected = 0, dense = 0;
+    for (int round = 0; round < 300; ++round) {
+        std::string const at =
+            std::string(t.name) + ", round " + std::to_string(round);
+        size_t n = random() % 120;
+        size_t m = n == 0 ? 0 : random() % (3 * n + 1);
+        bool acyclic = random() % 4 != 0;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < n; ++i) {
+            // a few rounds get a repeated name
+            names.push_back("x" + std::to_string(random() % (20 * n * n + 1)));
+        }
+        std::vector<char const *> values;
+        for (std::string const &name : names) {
+            values.push_back(name.c_str());
+        }
+        // acyclic edges go forward in a random order of the names
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), random);
+        std::vector<size_t> edges;
+        for (size_t i = 0; i < m; ++i) {
+            size_t a = random() % n, b = random() % n;
+            if (acyclic) {
+                if (a == b) {
+                    continue;
+                }
+                std::tie(a, b) = std::make_pair(order[std::min(a, b)],
+                                                order[std::max(a, b)]);
+            }
+            edges.push_back(a);
+            edges.push_back(b);
+        }
+        if (n > 0 && random() % 10 == 0) {
+            edges.push_back(n + random() % 3);
+            edges.push_back(0);
+        }
+        unsigned long p = 0;
+        bool created = poset_from_edges(values.data(), n, edges.data(),
+                                        edges.size() / 2, &p);
+        unsigned long q = poset_new();
+        bool expected = true;
+        for (char const *value : values) {
+            expected = poset_insert(q, value) && expected;
+        }
+        for (size_t i = 0; i < edges.size(); i += 2) {
+            if (edges[i] >= n || edges[i + 1] >= n) {
+                expected = false;
+                continue;
+            }
+            char const *a = values[edges[i]], *b = values[edges[i + 1]];
+            if (edges[i] == edges[i + 1] || poset_test(q, b, a)) {
+                expected = false;
+            }
+            poset_add(q, a, b);
+        }
+        check(created == expected, "from_edges result, " + at);
+        if (!created || !expected) {
+            rejected += !created;
+            if (created) {
+                poset_delete(p);
+            }
+            poset_delete(q);
+            continue;
+        }
+        ++built;
+        poset_stats stats;
+        poset_get_stats(p, &stats);
+        dense += stats.dense;
+        check(same_posets(p, q, names), "from_edges relations, " + at);
+        // the poset it builds has to keep working like any other
+        for (int i = 0; i < 200 && n > 0; ++i) {
+            char const *a = values[random() % n], *b = values[random() % n];
+            unsigned op = random() % 3;
+            bool x = op == 0 ? poset_add(p, a, b)
+                     : op == 1 ? poset_del(p, a, b)
+                               : poset_remove(p, a) && poset_insert(p, a);
+            bool y = op == 0 ? poset_add(q, a, b)
+                     : op == 1 ? poset_del(q, a, b)
+                               : poset_remove(q, a) && poset_insert(q, a);
+            check(x == y, "change after from_edges, " + at);
+        }
+        check(same_posets(p, q, names), "relations after changes, " + at);
+        poset_delete(p);
+        poset_delete(q);
+    }
+
+    char const *abc[] = {"a", "b", "c"};
+    std::vector<char const *> three(abc, abc + 3);
+    check(from_edges_fails(three, {0, 1, 1, 2, 2, 0}), "cycle");
+    check(from_edges_fails(three, {0, 1, 1, 1}), "self-loop");
+    check(from_edges_fails(three, {0, 1, 1, 0}), "two-element cycle");
+    check(from_edges_fails({"a", "b", "a"}, {}), "repeated name");
+    check(from_edges_fails({"a", nullptr, "c"}, {0, 2}), "null name");
+    check(from_edges_fails(three, {0, 3}), "edge out of range");
+    check(from_edges_fails({}, {0, 0}), "edge without names");
+    unsigned long p = 0;
+    check(!poset_from_edges(abc, 3, nullptr, 0, nullptr) &&
+              !poset_from_edges(nullptr, 3, nullptr, 0, &p) &&
+              !poset_from_edges(abc, 3, nullptr, 1, &p),
+          "missing arrays");
+    check(poset_from_edges(nullptr, 0, nullptr, 0, &p) && poset_size(p) == 0,
+          "empty poset");
+    poset_delete(p);
+    size_t const chain[] = {0, 1, 1, 2, 0, 1};
+    check(poset_from_edges(abc, 3, chain, 3, &p) &&
+              poset_test(p, "a", "c") && !poset_test(p, "c", "a") &&
+              poset_size(p) == 3,
+          "chain with a repeated edge");
+    poset_delete(p);
+    std::cout << t.name << ": " << built << " posets compared, " << rejected
+              << " rejected, " << dense << " built as bit matrices\n";
+}
+} // namespace
+
+int test1() {
+    int before = failures;
+    for (thresholds const &t : settings) {
+        check(poset_set_thresholds(t.min_dense_size, t.dense_density,
+                                   t.sparse_density),
+              std::string("thresholds ") + t.name);
+        compare_handles(t, 1);
+    }
+    poset_set_thresholds(settings[0].min_dense_size, settings[0].dense_density,
+                         settings[0].sparse_density);
+    return failures - before;
+}
+
+int test2() {
+    int before = failures;
+    for (thresholds const &t : settings) {
+        poset_set_thresholds(t.min_dense_size, t.dense_density,
+                             t.sparse_density);
+        compare_batches(t, 2);
+    }
+    poset_set_thresholds(settings[0].min_dense_size, settings[0].dense_density,
+                         settings[0].sparse_density);
+    return failures - before;
+}
+
+int test3() {
+    int before = failures;
+    for (thresholds const &t : settings) {
+        poset_set_thresholds(t.min_dense_size, t.dense_density,
+                             t.sparse_density);
+        compare_from_edges(t, 3);
+    }
+    poset_set_thresholds(settings[0].min_dense_size, settings[0].dense_density,
+                         settings[0].sparse_density);
+    return failures - before;
+}
+
+// Stats of a chain, whose relations are known, while the thresholds move its
+// storage back and forth; and the thresholds that must be refused.
+int test4() {
+    int before = failures;
+    thresholds const &d = settings[0];
+    poset_stats stats = {1, 1, true};
+    unsigned long p = poset_new();
+    check(poset_get_stats(p, &stats) && stats.elements == 0 &&
+              stats.relations == 0 && !stats.dense,
+          "stats of an empty poset");
+    check(!poset_get_stats(p, nullptr), "stats without a result");
+    std::vector<std::string> names = make_names(100);
+    auto chain_stats = [&](size_t n, bool dense, std::string const &what) {
+        check(poset_get_stats(p, &stats) && stats.elements == n &&
+                  stats.relations == n * (n - 1) / 2 && stats.dense == dense,
+              what);
+    };
+    for (size_t i = 0; i < names.size(); ++i) {
+        poset_insert(p, names[i].c_str());
+        if (i > 0) {
+            poset_add(p, names[i - 1].c_str(), names[i].c_str());
+        }
+        // defaults: sorted lists below 64 elements, bit matrices from there
+        chain_stats(i + 1, i + 1 >= d.min_dense_size,
+                    "stats of a growing chain, " + std::to_string(i + 1));
+    }
+    // new thresholds apply at the next change
+    check(poset_set_thresholds(1000, 1, 1), "thresholds for sorted lists");
+    chain_stats(100, true, "stats before a change");
+    poset_insert(p, "extra");
+    poset_remove(p, "extra");
+    chain_stats(100, false, "stats after a change");
+    check(poset_set_thresholds(0, 0, 0), "thresholds for bit matrices");
+    poset_add(p, names[0].c_str(), names[1].c_str());
+    chain_stats(100, false, "adding a known relation changes nothing");
+    poset_insert(p, "extra");
+    poset_remove(p, "extra");
+    chain_stats(100, true, "stats after another change");
+    // refused thresholds leave the last valid ones in place
+    double const nan = std::numeric_limits<double>::quiet_NaN();
+    check(!poset_set_thresholds(1000, 0.5, 0.6) &&
+              !poset_set_thresholds(1000, 1.5, 0) &&
+              !poset_set_thresholds(1000, 0.5, -0.1) &&
+              !poset_set_thresholds(1000, nan, 0) &&
+              !poset_set_thresholds(1000, 1, nan),
+          "invalid thresholds");
+    poset_insert(p, "extra");
+    poset_remove(p, "extra");
+    chain_stats(100, true, "stats after invalid thresholds");
+    check(poset_set_thresholds(d.min_dense_size, d.dense_density,
+                               d.sparse_density),
+          "default thresholds");
+    // the shorter chain is below min_dense_size again
+    for (size_t i = 99; i >= 40; --i) {
+        poset_remove(p, names[i].c_str());
+    }
+    chain_stats(40, false, "stats of a shortened chain");
+    poset_clear(p);
+    chain_stats(0, false, "stats after clear");
+    poset_delete(p);
+    check(!poset_get_stats(p, &stats), "stats of a deleted poset");
+    std::cout << "chain stats checked\n";
+    return failures - before;
+}
+
+int main() {
+    std::cout << "\nTEST 1\n";
+    test1();
+
+    std::cout << "\nTEST 2\n";
+    test2();
+
+    std::cout << "\nTEST 3\n";
+    test3();
+
+    std::cout << "\nTEST 4\n";
+    test4();
+
+    std::cout << (failures == 0 ? "\nOK\n" : "\nFAILED\n");
+    return failures == 0 ? 0 : 1;
+}